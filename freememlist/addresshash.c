@@ -0,0 +1,161 @@
+//
+//  addresshash.c
+//  freememlist
+//
+//  Created by Kevin Carter on 6/9/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+#include <stdlib.h>
+#include "addresshash.h"
+
+#define AH_MINIMUM_CAPACITY 16
+
+/*
+ * Block addresses are usually dense and sequential; the multiply spreads
+ * them across the table so neighbouring blocks do not form one long run.
+ */
+static unsigned long ah_slotFor(AddressHash *hash, long key) {
+    unsigned long long mixed = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+    return (unsigned long) (mixed ^ (mixed >> 32)) & (unsigned long) (hash->capacity-1);
+}
+
+static int ah_resize(AddressHash *hash, long newCapacity) {
+    int retval = AH_SUCCESS;
+    long i;
+    unsigned long slot;
+    AddressHashSlot *oldSlots = hash->slots;
+    long oldCapacity = hash->capacity;
+    AddressHashSlot *newSlots = calloc(newCapacity, sizeof(*newSlots));
+    
+    if(newSlots==NULL) {
+        retval = AH_ERR_ALLOCATION_FAILED;
+    } else {
+        hash->slots=newSlots;
+        hash->capacity=newCapacity;
+        for(i=0;i<oldCapacity;i++) {
+            if(oldSlots[i].value!=NULL) {
+                for(slot=ah_slotFor(hash, oldSlots[i].key);
+                    newSlots[slot].value!=NULL;
+                    slot=(slot+1) & (newCapacity-1));
+                newSlots[slot]=oldSlots[i];
+            }
+        }
+        free(oldSlots);
+    }
+    return retval;
+}
+
+int ah_initialize(AddressHash *hash, long initialCapacity) {
+    int retval = AH_SUCCESS;
+    long capacity = AH_MINIMUM_CAPACITY;
+    
+    if(hash==NULL) {
+        retval = AH_NULL_HASH;
+    } else {
+        while(capacity < initialCapacity*2) {
+            capacity*=2;
+        }
+        hash->count=0;
+        hash->capacity=capacity;
+        hash->slots=calloc(capacity, sizeof(*hash->slots));
+        if(hash->slots==NULL) {
+            hash->capacity=0;
+            retval = AH_ERR_ALLOCATION_FAILED;
+        }
+    }
+    return retval;
+}
+
+void ah_destroy(AddressHash *hash) {
+    if(hash!=NULL) {
+        free(hash->slots);
+        hash->slots=NULL;
+        hash->capacity=hash->count=0;
+    }
+}
+
+void ah_clear(AddressHash *hash) {
+    long i;
+    if(hash!=NULL && hash->count>0) {
+        for(i=0;i<hash->capacity;i++) {
+            hash->slots[i].value=NULL;
+        }
+        hash->count=0;
+    }
+}
+
+int ah_put(AddressHash *hash, long key, void *value) {
+    int retval = AH_SUCCESS;
+    unsigned long slot;
+    
+    if(hash==NULL) {
+        retval = AH_NULL_HASH;
+    } else if(value==NULL) {
+        retval = AH_ERR_NULL_VALUE;
+    } else {
+        if(hash->capacity==0) {
+            retval = ah_initialize(hash, 0);
+        } else if((hash->count+1)*2 > hash->capacity) {
+            retval = ah_resize(hash, hash->capacity*2);
+        }
+        
+        if(retval==AH_SUCCESS) {
+            for(slot=ah_slotFor(hash, key);
+                hash->slots[slot].value!=NULL && hash->slots[slot].key!=key;
+                slot=(slot+1) & (hash->capacity-1));
+            
+            if(hash->slots[slot].value==NULL) {
+                hash->count++;
+            }
+            hash->slots[slot].key=key;
+            hash->slots[slot].value=value;
+        }
+    }
+    return retval;
+}
+
+void *ah_get(AddressHash *hash, long key) {
+    void *retval = NULL;
+    unsigned long slot;
+    
+    if(hash!=NULL && hash->count>0) {
+        for(slot=ah_slotFor(hash, key);
+            hash->slots[slot].value!=NULL && hash->slots[slot].key!=key;
+            slot=(slot+1) & (hash->capacity-1));
+        retval=hash->slots[slot].value;
+    }
+    return retval;
+}
+
+void *ah_remove(AddressHash *hash, long key) {
+    void *retval = NULL;
+    unsigned long mask;
+    unsigned long slot;
+    unsigned long next;
+    unsigned long home;
+    
+    if(hash!=NULL && hash->count>0) {
+        mask=hash->capacity-1;
+        for(slot=ah_slotFor(hash, key);
+            hash->slots[slot].value!=NULL && hash->slots[slot].key!=key;
+            slot=(slot+1) & mask);
+        
+        if((retval=hash->slots[slot].value)!=NULL) {
+            hash->count--;
+            /*
+             * Pull back any later member of the run whose home slot is
+             * not between the hole and its current position, so every
+             * key stays reachable from its home slot.
+             */
+            for(next=(slot+1) & mask; hash->slots[next].value!=NULL; next=(next+1) & mask) {
+                home=ah_slotFor(hash, hash->slots[next].key);
+                if(((next-home) & mask) >= ((next-slot) & mask)) {
+                    hash->slots[slot]=hash->slots[next];
+                    slot=next;
+                }
+            }
+            hash->slots[slot].value=NULL;
+        }
+    }
+    return retval;
+}
@@ -0,0 +1,69 @@
+//
+//  addresshash.h
+//  freememlist
+//
+//  Created by Kevin Carter on 6/9/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_addresshash_h
+#define freememlist_addresshash_h
+
+#define AH_SUCCESS 0
+#define AH_ERR_ALLOCATION_FAILED 1
+#define AH_ERR_NULL_VALUE 2
+#define AH_NULL_HASH 3
+
+typedef struct AddressHashSlot AddressHashSlot;
+typedef struct AddressHash AddressHash;
+
+struct AddressHashSlot {
+    long key;
+    void *value;
+};
+
+/*
+ * An open-addressing (linear probing) map from block addresses to
+ * pointers. A NULL value marks an empty slot, so NULL cannot be stored.
+ * Removal shifts the following run back instead of leaving tombstones,
+ * so lookups of absent keys stay short however many removals happen.
+ */
+struct AddressHash {
+    AddressHashSlot *slots;
+    long capacity;
+    long count;
+};
+
+/*
+ * Prepares hash to hold at least initialCapacity keys before it has to
+ * grow. The table doubles whenever it becomes more than half full.
+ */
+int ah_initialize(AddressHash *hash, long initialCapacity);
+
+/*
+ * Releases the slot table. The stored values are not touched.
+ */
+void ah_destroy(AddressHash *hash);
+
+/*
+ * Removes every key while keeping the current slot table.
+ */
+void ah_clear(AddressHash *hash);
+
+/*
+ * Associates value with key, replacing any existing association.
+ */
+int ah_put(AddressHash *hash, long key, void *value);
+
+/*
+ * Returns the value associated with key or NULL if there is none.
+ */
+void *ah_get(AddressHash *hash, long key);
+
+/*
+ * Removes key and returns the value it was associated with, or NULL if
+ * key was not present.
+ */
+void *ah_remove(AddressHash *hash, long key);
+
+#endif
@@ -0,0 +1,425 @@
+//
+//  bitmap.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/16/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "bitmap.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BM_ALL_ONES (~(uint64_t) 0)
+
+#define bm_wordsFor(bits) ((bits)/BM_WORD_BITS + ((bits)%BM_WORD_BITS!=0))
+
+static void bm_updateFull(BitmapAllocator *allocator, long word) {
+    uint64_t bit = (uint64_t) 1 << (word % BM_WORD_BITS);
+    if(allocator->used[word]==BM_ALL_ONES) {
+        allocator->full[word/BM_WORD_BITS] |= bit;
+    } else {
+        allocator->full[word/BM_WORD_BITS] &= ~bit;
+    }
+}
+
+/*
+ * Sets (value non-zero) or clears bits from..to-1 of map, a word at a
+ * time. When map is the used map the full summary is kept in step.
+ */
+static void bm_setRange(BitmapAllocator *allocator, uint64_t *map, long from, long to, int value) {
+    long word;
+    long lastWord = (to-1)/BM_WORD_BITS;
+    uint64_t mask;
+    
+    for(word=from/BM_WORD_BITS;word<=lastWord;word++) {
+        mask = BM_ALL_ONES;
+        if(word==from/BM_WORD_BITS) {
+            mask &= BM_ALL_ONES << (from % BM_WORD_BITS);
+        }
+        if(word==lastWord && to % BM_WORD_BITS!=0) {
+            mask &= BM_ALL_ONES >> (BM_WORD_BITS - to % BM_WORD_BITS);
+        }
+        if(value) {
+            map[word] |= mask;
+        } else {
+            map[word] &= ~mask;
+        }
+        if(map==allocator->used) {
+            bm_updateFull(allocator, word);
+        }
+    }
+}
+
+#define bm_testBit(map, bit) (((map)[(bit)/BM_WORD_BITS] >> ((bit) % BM_WORD_BITS)) & 1)
+
+/*
+ * Returns the first bit at or after from that is set (wantSet non-zero)
+ * or clear in map, or wordCount*64 if there is none.
+ */
+static long bm_nextBit(uint64_t *map, long wordCount, long from, int wantSet) {
+    long word = from/BM_WORD_BITS;
+    uint64_t bits;
+    
+    if(word>=wordCount) {
+        return wordCount*BM_WORD_BITS;
+    }
+    bits = (wantSet ? map[word] : ~map[word]) & (BM_ALL_ONES << (from % BM_WORD_BITS));
+    while(bits==0) {
+        if(++word>=wordCount) {
+            return wordCount*BM_WORD_BITS;
+        }
+        bits = (wantSet ? map[word] : ~map[word]);
+    }
+    return word*BM_WORD_BITS + __builtin_ctzll(bits);
+}
+
+/*
+ * Returns the last bit at or before from that is set (wantSet non-zero)
+ * or clear in map, or -1 if there is none.
+ */
+static long bm_previousBit(uint64_t *map, long from, int wantSet) {
+    long word = from/BM_WORD_BITS;
+    uint64_t bits;
+    
+    bits = (wantSet ? map[word] : ~map[word]) & (BM_ALL_ONES >> (BM_WORD_BITS-1 - from % BM_WORD_BITS));
+    while(bits==0) {
+        if(--word<0) {
+            return -1;
+        }
+        bits = (wantSet ? map[word] : ~map[word]);
+    }
+    return word*BM_WORD_BITS + BM_WORD_BITS-1 - __builtin_clzll(bits);
+}
+
+/*
+ * Returns the first used word at or after word that is not all ones,
+ * stepping through the full summary 64 words at a time.
+ */
+static long bm_nextNotFull(BitmapAllocator *allocator, long word) {
+    long summary = word/BM_WORD_BITS;
+    uint64_t bits;
+    
+    if(summary>=allocator->fullCount) {
+        return allocator->wordCount;
+    }
+    bits = ~allocator->full[summary] & (BM_ALL_ONES << (word % BM_WORD_BITS));
+    while(bits==0) {
+        if(++summary>=allocator->fullCount) {
+            return allocator->wordCount;
+        }
+        bits = ~allocator->full[summary];
+    }
+    word = summary*BM_WORD_BITS + __builtin_ctzll(bits);
+    return word<allocator->wordCount ? word : allocator->wordCount;
+}
+
+/*
+ * Returns the first word in from..to-1 that is not zero, or to. This is
+ * where long runs are measured, so whole vectors of free words are
+ * tested at once where the target has SSE2 or AVX2.
+ */
+static long bm_nextNotEmpty(const uint64_t *words, long from, long to) {
+    long word = from;
+#if defined(__AVX2__)
+    __m256i vector;
+    for(;word+4<=to;word+=4) {
+        vector = _mm256_loadu_si256((const __m256i *) (words+word));
+        if(!_mm256_testz_si256(vector, vector)) {
+            break;
+        }
+    }
+#elif defined(__SSE2__)
+    __m128i vector;
+    __m128i zero = _mm_setzero_si128();
+    for(;word+2<=to;word+=2) {
+        vector = _mm_loadu_si128((const __m128i *) (words+word));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(vector, zero))!=0xFFFF) {
+            break;
+        }
+    }
+#endif
+    while(word<to && words[word]==0) {
+        word++;
+    }
+    return word;
+}
+
+/*
+ * Returns a mask of the bit positions in freeBits where a run of length
+ * free bits (1 to 64) starts and fits inside the word. Each step doubles
+ * the run length tested, so this takes O(log length) operations.
+ */
+static uint64_t bm_runStarts(uint64_t freeBits, long length) {
+    long tested = 1;
+    long shift;
+    while(tested<length && freeBits!=0) {
+        shift = (tested < length-tested ? tested : length-tested);
+        freeBits &= freeBits >> shift;
+        tested += shift;
+    }
+    return freeBits;
+}
+
+/*
+ * Finds the lowest run of length free blocks. run carries the free bits
+ * at the top of the previous word into the next so runs may span words;
+ * while no run is open, full words are skipped through the summary.
+ */
+static long bm_findRun(BitmapAllocator *allocator, long length) {
+    long word = 0;
+    long run = 0;
+    long runStart = 0;
+    long emptyEnd;
+    long freeLow;
+    uint64_t bits;
+    uint64_t starts;
+    
+    while(word<allocator->wordCount) {
+        if(run==0) {
+            word = bm_nextNotFull(allocator, word);
+            if(word>=allocator->wordCount) {
+                break;
+            }
+        }
+        bits = allocator->used[word];
+        
+        if(bits==0) {
+            if(run==0) {
+                runStart = word*BM_WORD_BITS;
+            }
+            emptyEnd = bm_nextNotEmpty(allocator->used, word, allocator->wordCount);
+            run += (emptyEnd-word)*BM_WORD_BITS;
+            if(run>=length) {
+                return runStart;
+            }
+            word = emptyEnd;
+            continue;
+        }
+        
+        freeLow = __builtin_ctzll(bits);
+        if(run>0 && run+freeLow>=length) {
+            return runStart;
+        }
+        if(length<=BM_WORD_BITS) {
+            starts = bm_runStarts(~bits, length);
+            if(starts!=0) {
+                return word*BM_WORD_BITS + __builtin_ctzll(starts);
+            }
+        }
+        
+        run = __builtin_clzll(bits);
+        runStart = (word+1)*BM_WORD_BITS - run;
+        word++;
+    }
+    return -1;
+}
+
+/*
+ * Returns the first free block at or after from, stepping over full
+ * words through the summary, or wordCount*64 if there is none.
+ */
+static long bm_nextFree(BitmapAllocator *allocator, long from) {
+    long word = from/BM_WORD_BITS;
+    uint64_t bits = 0;
+    
+    if(word<allocator->wordCount) {
+        bits = ~allocator->used[word] & (BM_ALL_ONES << (from % BM_WORD_BITS));
+    }
+    if(bits==0) {
+        word = bm_nextNotFull(allocator, word+1);
+        if(word>=allocator->wordCount) {
+            return allocator->wordCount*BM_WORD_BITS;
+        }
+        bits = ~allocator->used[word];
+    }
+    return word*BM_WORD_BITS + __builtin_ctzll(bits);
+}
+
+/*
+ * Finds the lowest run of length free blocks starting at a multiple of
+ * alignment. Only aligned starts are tried: when one is blocked the
+ * search moves to the first free block past the blocking one and rounds
+ * up, so allocated stretches are crossed through the full summary
+ * rather than one aligned start at a time.
+ */
+static long bm_findAlignedRun(BitmapAllocator *allocator, long length, long alignment) {
+    long candidate = 0;
+    long blocked;
+    
+    while(candidate<=allocator->blockCount-length) {
+        blocked = bm_nextBit(allocator->used, allocator->wordCount, candidate, 1);
+        if(blocked>=candidate+length) {
+            return candidate;
+        }
+        candidate = bm_nextFree(allocator, blocked);
+        candidate = (candidate+alignment-1) & ~(alignment-1);
+    }
+    return -1;
+}
+
+static long bm_allocationEnd(BitmapAllocator *allocator, long start) {
+    long end = bm_nextBit(allocator->used, allocator->wordCount, start, 0);
+    long nextStart = bm_nextBit(allocator->starts, allocator->wordCount, start+1, 1);
+    if(nextStart<end) {
+        end = nextStart;
+    }
+    return end<allocator->blockCount ? end : allocator->blockCount;
+}
+
+int bm_initialize(BitmapAllocator *allocator, long blockCount) {
+    int retval = BM_SUCCESS;
+    
+    if(allocator==NULL) {
+        retval = BM_NULL_ALLOCATOR;
+    } else if(blockCount<0 || blockCount>BM_MAX_BLOCKS) {
+        retval = BM_ERR_BAD_SIZE;
+    } else {
+        bm_destroy(allocator);
+        allocator->blockCount = blockCount;
+        allocator->wordCount = bm_wordsFor(allocator->blockCount);
+        allocator->fullCount = bm_wordsFor(allocator->wordCount);
+        allocator->used = calloc(allocator->wordCount+1, sizeof(uint64_t));
+        allocator->starts = calloc(allocator->wordCount+1, sizeof(uint64_t));
+        allocator->full = calloc(allocator->fullCount+1, sizeof(uint64_t));
+        
+        if(allocator->used==NULL || allocator->starts==NULL || allocator->full==NULL) {
+            bm_destroy(allocator);
+            retval = BM_ERR_ALLOCATION_FAILED;
+        } else if(allocator->blockCount < allocator->wordCount*BM_WORD_BITS) {
+            bm_setRange(allocator, allocator->used, allocator->blockCount, allocator->wordCount*BM_WORD_BITS, 1);
+        }
+    }
+    return retval;
+}
+
+void bm_destroy(BitmapAllocator *allocator) {
+    if(allocator!=NULL) {
+        free(allocator->used);
+        free(allocator->starts);
+        free(allocator->full);
+        memset(allocator, 0, sizeof(*allocator));
+    }
+}
+
+int bm_allocate(BitmapAllocator *allocator, long requestedSize, long *acquiredAddress) {
+    return bm_allocateAligned(allocator, requestedSize, 1, acquiredAddress);
+}
+
+int bm_allocateAligned(BitmapAllocator *allocator, long requestedSize, long alignment, long *acquiredAddress) {
+    int retval = BM_ERR_NO_CONTIGUOUS;
+    long start;
+    
+    if(allocator==NULL) {
+        retval = BM_NULL_ALLOCATOR;
+    } else if(requestedSize>0 && requestedSize<=allocator->blockCount) {
+        start = (alignment>1 ? bm_findAlignedRun(allocator, requestedSize, alignment)
+                             : bm_findRun(allocator, requestedSize));
+        if(start>=0) {
+            bm_setRange(allocator, allocator->used, start, start+requestedSize, 1);
+            bm_setRange(allocator, allocator->starts, start, start+1, 1);
+            *acquiredAddress = start;
+            retval = BM_SUCCESS;
+        }
+    }
+    return retval;
+}
+
+int bm_free(BitmapAllocator *allocator, long blockBaseAddress) {
+    int retval = BM_ERR_NOT_ALLOCATED;
+    
+    if(allocator==NULL) {
+        retval = BM_NULL_ALLOCATOR;
+    } else if(blockBaseAddress>=0 && blockBaseAddress<allocator->blockCount
+              && bm_testBit(allocator->starts, blockBaseAddress)) {
+        bm_setRange(allocator, allocator->used, blockBaseAddress, bm_allocationEnd(allocator, blockBaseAddress), 0);
+        bm_setRange(allocator, allocator->starts, blockBaseAddress, blockBaseAddress+1, 0);
+        retval = BM_SUCCESS;
+    }
+    return retval;
+}
+
+int bm_resize(BitmapAllocator *allocator, long blockBaseAddress, long newSize) {
+    int retval = BM_ERR_NOT_ALLOCATED;
+    long end;
+    long newEnd = blockBaseAddress+newSize;
+    
+    if(allocator==NULL) {
+        retval = BM_NULL_ALLOCATOR;
+    } else if(blockBaseAddress>=0 && blockBaseAddress<allocator->blockCount
+              && bm_testBit(allocator->starts, blockBaseAddress)) {
+        end = bm_allocationEnd(allocator, blockBaseAddress);
+        retval = BM_SUCCESS;
+        if(newSize<=0) {
+            retval = BM_ERR_NO_CONTIGUOUS;
+        } else if(newEnd<end) {
+            bm_setRange(allocator, allocator->used, newEnd, end, 0);
+        } else if(newEnd>end) {
+            if(newEnd<=allocator->blockCount && bm_nextBit(allocator->used, allocator->wordCount, end, 1)>=newEnd) {
+                bm_setRange(allocator, allocator->used, end, newEnd, 1);
+            } else {
+                retval = BM_ERR_NO_CONTIGUOUS;
+            }
+        }
+    }
+    return retval;
+}
+
+long bm_allocationSize(BitmapAllocator *allocator, long blockBaseAddress) {
+    long retval = 0;
+    if(allocator!=NULL && blockBaseAddress>=0 && blockBaseAddress<allocator->blockCount
+       && bm_testBit(allocator->starts, blockBaseAddress)) {
+        retval = bm_allocationEnd(allocator, blockBaseAddress)-blockBaseAddress;
+    }
+    return retval;
+}
+
+int bm_freeRun(BitmapAllocator *allocator, long address, long *runStart, long *runEnd) {
+    int retval = BM_ERR_NOT_FREE;
+    
+    if(allocator==NULL) {
+        retval = BM_NULL_ALLOCATOR;
+    } else if(address>=0 && address<allocator->blockCount && !bm_testBit(allocator->used, address)) {
+        *runStart = bm_previousBit(allocator->used, address, 1)+1;
+        *runEnd = bm_nextBit(allocator->used, allocator->wordCount, address, 1)-1;
+        retval = BM_SUCCESS;
+    }
+    return retval;
+}
+
+void bm_mapBlocks(BitmapAllocator *allocator, int isFree, void *mapParam, void (mapFunc)(long, long, void *)) {
+    long position = 0;
+    long start;
+    long end;
+    
+    if(allocator==NULL) {
+        return;
+    }
+    
+    while(position<allocator->blockCount) {
+        if(isFree) {
+            start = bm_nextBit(allocator->used, allocator->wordCount, position, 0);
+            if(start>=allocator->blockCount) {
+                break;
+            }
+            end = bm_nextBit(allocator->used, allocator->wordCount, start, 1);
+            if(end>allocator->blockCount) {
+                end = allocator->blockCount;
+            }
+        } else {
+            start = bm_nextBit(allocator->starts, allocator->wordCount, position, 1);
+            if(start>=allocator->blockCount) {
+                break;
+            }
+            end = bm_allocationEnd(allocator, start);
+        }
+        mapFunc(start, end-1, mapParam);
+        position = end;
+    }
+}
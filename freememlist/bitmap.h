@@ -0,0 +1,108 @@
+//
+//  bitmap.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/16/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_bitmap_h
+#define freememlist_bitmap_h
+
+#include <stdint.h>
+#include <limits.h>
+
+#define BM_SUCCESS 0
+#define BM_ERR_NO_CONTIGUOUS 1
+#define BM_ERR_NOT_ALLOCATED 2
+#define BM_ERR_ALLOCATION_FAILED 3
+#define BM_ERR_NOT_FREE 4
+#define BM_ERR_BAD_SIZE 5
+#define BM_NULL_ALLOCATOR -1
+
+#define BM_WORD_BITS 64
+
+/*
+ * The largest blockCount, which keeps wordCount*64 a positive long.
+ */
+#define BM_MAX_BLOCKS (LONG_MAX/BM_WORD_BITS*BM_WORD_BITS)
+
+/*
+ * One bit per block: bit i of used[w] is block w*64+i, set while the
+ * block is allocated. Bits past blockCount are permanently set so the
+ * scans never need a bounds check inside a word. full has one bit per
+ * used word, set when that word is all ones, so a search can step over
+ * 4096 allocated blocks at a time. starts marks the first block of
+ * every allocation; an allocation runs until the next start bit or the
+ * next free block, which is all free needs to recover its length.
+ *
+ * Placement is first-fit: the lowest-addressed run that is long enough.
+ */
+typedef struct BitmapAllocator {
+    uint64_t *used;
+    uint64_t *starts;
+    uint64_t *full;
+    long blockCount;
+    long wordCount;
+    long fullCount;
+} BitmapAllocator;
+
+/*
+ * (Re)initialises allocator over blockCount free blocks. A zero-filled
+ * BitmapAllocator may be passed the first time. A blockCount below 0 or
+ * above BM_MAX_BLOCKS gives BM_ERR_BAD_SIZE and leaves allocator as it
+ * was; one too large to allocate a bit for every block gives
+ * BM_ERR_ALLOCATION_FAILED.
+ */
+int bm_initialize(BitmapAllocator *allocator, long blockCount);
+
+/*
+ * Releases everything allocator holds. It may be initialised again
+ * afterwards.
+ */
+void bm_destroy(BitmapAllocator *allocator);
+
+/*
+ * Finds the lowest run of requestedSize free blocks, marks it used and
+ * stores its start in acquiredAddress.
+ */
+int bm_allocate(BitmapAllocator *allocator, long requestedSize, long *acquiredAddress);
+
+/*
+ * As bm_allocate, but the run starts at a multiple of alignment, a
+ * power of two. The blocks skipped to reach it stay free.
+ */
+int bm_allocateAligned(BitmapAllocator *allocator, long requestedSize, long alignment, long *acquiredAddress);
+
+/*
+ * Frees the allocation starting at blockBaseAddress.
+ */
+int bm_free(BitmapAllocator *allocator, long blockBaseAddress);
+
+/*
+ * Changes the allocation at blockBaseAddress to newSize blocks without
+ * moving it, freeing its tail or taking the blocks after it. Returns
+ * BM_ERR_NO_CONTIGUOUS, leaving the allocation as it was, if those
+ * blocks are not all free.
+ */
+int bm_resize(BitmapAllocator *allocator, long blockBaseAddress, long newSize);
+
+/*
+ * Returns how many blocks the allocation starting at blockBaseAddress
+ * holds, or 0 if no allocation starts there.
+ */
+long bm_allocationSize(BitmapAllocator *allocator, long blockBaseAddress);
+
+/*
+ * Stores the first and last block of the maximal free run containing
+ * address. Returns BM_ERR_NOT_FREE if address is used or out of range.
+ */
+int bm_freeRun(BitmapAllocator *allocator, long address, long *runStart, long *runEnd);
+
+/*
+ * Calls mapFunc with the first and last block of every maximal free run
+ * (isFree non-zero) or every allocation, in address order.
+ */
+void bm_mapBlocks(BitmapAllocator *allocator, int isFree, void *mapParam, void (mapFunc)(long, long, void *));
+
+#endif
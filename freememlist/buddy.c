@@ -0,0 +1,283 @@
+//
+//  buddy.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/14/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "buddy.h"
+
+static int bd_sortComparator(LinkedListEntry *context[], void *newData) {
+    int retval = LL_SORT_DO_NOT_INSERT_YET;
+    LinkedListEntry *nextentry = context[LL_SORT_CONTEXT_NEXT];
+    BuddyBlock *current = LL_CONTAINER_OF(context[LL_SORT_CONTEXT_CURRENT], BuddyBlock, link);
+    BuddyBlock *newBlock = newData;
+    
+    if(newBlock->start < current->start) {
+        retval = LL_SORT_INSERT_BEFORE_CURRENT;
+    } else if(nextentry==NULL || newBlock->start < LL_CONTAINER_OF(nextentry, BuddyBlock, link)->start) {
+        retval = LL_SORT_INSERT_AFTER_CURRENT;
+    }
+    return retval;
+}
+
+static LinkedList *bd_createList() {
+    LinkedList *list = ll_create();
+    ll_assignSortFunction(list, bd_sortComparator);
+    ll_enableSkipList(list);
+    return list;
+}
+
+static int bd_orderFor(long size) {
+    int order = 0;
+    while((1L << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+static BuddyBlock *bd_newBlock(BuddyAllocator *allocator, long start, int order) {
+    BuddyBlock *block = slab_alloc(&allocator->blockPool);
+    if(block!=NULL) {
+        memset(block, 0, sizeof(*block));
+        block->start = start;
+        block->order = order;
+        block->isFree = 1;
+        ah_put(&allocator->blocks, start, block);
+    }
+    return block;
+}
+
+static void bd_pushFree(BuddyAllocator *allocator, BuddyBlock *block) {
+    block->isFree = 1;
+    ll_appendEntry(allocator->freeLists[block->order], &block->link, block);
+}
+
+int bd_initialize(BuddyAllocator *allocator, long blockCount) {
+    int retval = BD_SUCCESS;
+    long start = 0;
+    int order;
+    BuddyBlock *block;
+    
+    if(allocator==NULL) {
+        retval = BD_NULL_ALLOCATOR;
+    } else if(blockCount<0 || blockCount>BD_MAX_BLOCKS) {
+        retval = BD_ERR_BAD_SIZE;
+    } else {
+        bd_destroy(allocator);
+        slab_initialize(&allocator->blockPool, sizeof(BuddyBlock));
+        allocator->blockCount = blockCount;
+        allocator->orderCount = (blockCount>0 ? (int) (sizeof(long)*8) - __builtin_clzl((unsigned long) blockCount) : 0);
+        for(order=0;order<allocator->orderCount;order++) {
+            allocator->freeLists[order] = bd_createList();
+        }
+        allocator->usedList = bd_createList();
+        
+        while(start < blockCount && retval==BD_SUCCESS) {
+            order = allocator->orderCount-1;
+            while((1L << order) > blockCount-start) {
+                order--;
+            }
+            block = bd_newBlock(allocator, start, order);
+            if(block==NULL) {
+                retval = BD_ERR_ALLOCATION_FAILED;
+            } else {
+                bd_pushFree(allocator, block);
+                start += 1L << order;
+            }
+        }
+    }
+    return retval;
+}
+
+void bd_destroy(BuddyAllocator *allocator) {
+    int order;
+    if(allocator!=NULL) {
+        for(order=0;order<allocator->orderCount;order++) {
+            ll_destroy(allocator->freeLists[order], NULL);
+        }
+        if(allocator->usedList!=NULL) {
+            ll_destroy(allocator->usedList, NULL);
+        }
+        ah_destroy(&allocator->blocks);
+        slab_releaseAll(&allocator->blockPool);
+        memset(allocator, 0, sizeof(*allocator));
+    }
+}
+
+int bd_allocate(BuddyAllocator *allocator, long requestedSize, long *acquiredAddress) {
+    return bd_allocateAligned(allocator, requestedSize, 1, acquiredAddress);
+}
+
+/*
+ * Every block starts at a multiple of its own size, and splitting keeps
+ * the lower half, so a block of the alignment's order or above always
+ * yields an aligned allocation. The only aligned start an alignment past
+ * the largest order allows is 0, which is first in its list if free.
+ */
+int bd_allocateAligned(BuddyAllocator *allocator, long requestedSize, long alignment, long *acquiredAddress) {
+    int retval = BD_ERR_NO_CONTIGUOUS;
+    int order;
+    int wanted;
+    BuddyBlock *block;
+    BuddyBlock *buddy;
+    
+    if(allocator==NULL) {
+        retval = BD_NULL_ALLOCATOR;
+    } else if(requestedSize>0 && requestedSize<=allocator->blockCount) {
+        wanted = bd_orderFor(requestedSize);
+        order = bd_orderFor(alignment);
+        if(order>=allocator->orderCount) {
+            order = allocator->orderCount-1;
+        }
+        if(order<wanted) {
+            order = wanted;
+        }
+        for(;order<allocator->orderCount &&
+            (allocator->freeLists[order]->first==NULL ||
+             LL_CONTAINER_OF(allocator->freeLists[order]->first, BuddyBlock, link)->start % alignment!=0);
+            order++) {
+            //Empty loop
+        }
+        
+        if(order<allocator->orderCount) {
+            block = LL_CONTAINER_OF(allocator->freeLists[order]->first, BuddyBlock, link);
+            ll_remove(&block->link, NULL);
+            
+            while(block->order > wanted) {
+                block->order--;
+                buddy = bd_newBlock(allocator, block->start + (1L << block->order), block->order);
+                if(buddy==NULL) {
+                    block->order++;
+                    break;
+                }
+                bd_pushFree(allocator, buddy);
+            }
+            
+            if(block->order > wanted) {
+                bd_pushFree(allocator, block);
+                retval = BD_ERR_ALLOCATION_FAILED;
+            } else {
+                block->isFree = 0;
+                block->requestedSize = requestedSize;
+                ll_appendEntry(allocator->usedList, &block->link, block);
+                allocator->requestedBlocks += requestedSize;
+                allocator->reservedBlocks += 1L << block->order;
+                *acquiredAddress = block->start;
+                retval = BD_SUCCESS;
+            }
+        }
+    }
+    return retval;
+}
+
+int bd_free(BuddyAllocator *allocator, long blockBaseAddress) {
+    int retval = BD_ERR_NOT_ALLOCATED;
+    BuddyBlock *block;
+    BuddyBlock *buddy;
+    BuddyBlock *upper;
+    long mergedStart;
+    long mergedSize;
+    
+    if(allocator==NULL) {
+        retval = BD_NULL_ALLOCATOR;
+    } else if((block = ah_get(&allocator->blocks, blockBaseAddress))!=NULL && !block->isFree) {
+        ll_remove(&block->link, NULL);
+        allocator->requestedBlocks -= block->requestedSize;
+        allocator->reservedBlocks -= 1L << block->order;
+        
+        while(block->order+1 < allocator->orderCount) {
+            mergedSize = 2L << block->order;
+            mergedStart = block->start & ~(mergedSize-1);
+            if(mergedStart+mergedSize > allocator->blockCount) {
+                break;
+            }
+            buddy = ah_get(&allocator->blocks, block->start ^ (1L << block->order));
+            if(buddy==NULL || !buddy->isFree || buddy->order!=block->order) {
+                break;
+            }
+            
+            ll_remove(&buddy->link, NULL);
+            if(buddy->start < block->start) {
+                upper = block;
+                block = buddy;
+                buddy = upper;
+            }
+            ah_remove(&allocator->blocks, buddy->start);
+            slab_free(buddy);
+            block->order++;
+        }
+        
+        bd_pushFree(allocator, block);
+        retval = BD_SUCCESS;
+    }
+    return retval;
+}
+
+int bd_resize(BuddyAllocator *allocator, long blockBaseAddress, long newSize) {
+    int retval = BD_ERR_NOT_ALLOCATED;
+    BuddyBlock *block;
+    
+    if(allocator==NULL) {
+        retval = BD_NULL_ALLOCATOR;
+    } else if((block = ah_get(&allocator->blocks, blockBaseAddress))!=NULL && !block->isFree) {
+        retval = BD_ERR_NO_CONTIGUOUS;
+        if(newSize>0 && bd_orderFor(newSize)==block->order) {
+            allocator->requestedBlocks += newSize-block->requestedSize;
+            block->requestedSize = newSize;
+            retval = BD_SUCCESS;
+        }
+    }
+    return retval;
+}
+
+static int bd_compareStart(const void *left, const void *right) {
+    long a = (*(BuddyBlock * const *) left)->start;
+    long b = (*(BuddyBlock * const *) right)->start;
+    return (a>b) - (a<b);
+}
+
+/*
+ * Free blocks are spread over one list per order, so they are gathered
+ * and sorted; only print needs them in address order.
+ */
+void bd_mapBlocks(BuddyAllocator *allocator, int isFree, void *mapParam, void (mapFunc)(long, long, void *)) {
+    LinkedListEntry *entry;
+    BuddyBlock *block;
+    BuddyBlock **gathered;
+    long count = 0;
+    long i;
+    int order;
+    
+    if(allocator==NULL || allocator->usedList==NULL) {
+        return;
+    }
+    
+    if(!isFree) {
+        for(entry=allocator->usedList->first;entry!=NULL;entry=entry->next) {
+            block = LL_CONTAINER_OF(entry, BuddyBlock, link);
+            mapFunc(block->start, block->start + (1L << block->order) - 1, mapParam);
+        }
+    } else {
+        for(order=0;order<allocator->orderCount;order++) {
+            count += allocator->freeLists[order]->nodeCount;
+        }
+        gathered = malloc(sizeof(BuddyBlock *) * (count>0 ? count : 1));
+        if(gathered!=NULL) {
+            count = 0;
+            for(order=0;order<allocator->orderCount;order++) {
+                for(entry=allocator->freeLists[order]->first;entry!=NULL;entry=entry->next) {
+                    gathered[count++] = LL_CONTAINER_OF(entry, BuddyBlock, link);
+                }
+            }
+            qsort(gathered, count, sizeof(BuddyBlock *), bd_compareStart);
+            for(i=0;i<count;i++) {
+                mapFunc(gathered[i]->start, gathered[i]->start + (1L << gathered[i]->order) - 1, mapParam);
+            }
+            free(gathered);
+        }
+    }
+}
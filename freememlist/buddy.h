@@ -0,0 +1,113 @@
+//
+//  buddy.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/14/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_buddy_h
+#define freememlist_buddy_h
+
+#include "llist.h"
+#include "addresshash.h"
+#include "slab.h"
+
+#define BD_SUCCESS 0
+#define BD_ERR_NO_CONTIGUOUS 1
+#define BD_ERR_NOT_ALLOCATED 2
+#define BD_ERR_ALLOCATION_FAILED 3
+#define BD_ERR_BAD_SIZE 4
+#define BD_NULL_ALLOCATOR -1
+
+#define BD_MAX_ORDER 63
+
+/*
+ * The largest blockCount, which keeps every order below BD_MAX_ORDER
+ * and every 2^order a positive long.
+ */
+#define BD_MAX_BLOCKS (1L << (BD_MAX_ORDER-1))
+
+/*
+ * A block of 2^order blocks starting at start, which is always a
+ * multiple of 2^order. A free block sits on freeLists[order], a used one
+ * on usedList; requestedSize is what the allocation asked for, the rest
+ * of the block being internal fragmentation.
+ */
+typedef struct BuddyBlock {
+    long start;
+    long requestedSize;
+    int order;
+    int isFree;
+    LinkedListEntry link;
+} BuddyBlock;
+
+/*
+ * A binary buddy system over blocks 0..blockCount-1. A blockCount that
+ * is not a power of two is covered by one top-level block per set bit,
+ * largest first, and blocks never merge past the top-level block they
+ * came from. Every list is kept in address order so allocation always
+ * splits the lowest-addressed block of the smallest order that fits.
+ * blocks maps the start of every block, free or used, to its
+ * BuddyBlock, which is how a block's buddy (start XOR 2^order) is found.
+ */
+typedef struct BuddyAllocator {
+    LinkedList *freeLists[BD_MAX_ORDER];
+    LinkedList *usedList;
+    AddressHash blocks;
+    SlabPool blockPool;
+    long blockCount;
+    int orderCount;
+    long requestedBlocks;
+    long reservedBlocks;
+} BuddyAllocator;
+
+/*
+ * (Re)initialises allocator over blockCount free blocks. A zero-filled
+ * BuddyAllocator may be passed the first time. A blockCount below 0 or
+ * above BD_MAX_BLOCKS gives BD_ERR_BAD_SIZE and leaves allocator as it
+ * was.
+ */
+int bd_initialize(BuddyAllocator *allocator, long blockCount);
+
+/*
+ * Releases everything allocator holds. It may be initialised again
+ * afterwards.
+ */
+void bd_destroy(BuddyAllocator *allocator);
+
+/*
+ * Reserves the smallest power-of-two block that holds requestedSize
+ * blocks, splitting larger blocks as needed, and stores its start in
+ * acquiredAddress.
+ */
+int bd_allocate(BuddyAllocator *allocator, long requestedSize, long *acquiredAddress);
+
+/*
+ * As bd_allocate, but the block starts at a multiple of alignment, a
+ * power of two. It is split from a block of at least the alignment's
+ * size, so the halves split off stay free for other allocations.
+ */
+int bd_allocateAligned(BuddyAllocator *allocator, long requestedSize, long alignment, long *acquiredAddress);
+
+/*
+ * Frees the block starting at blockBaseAddress and merges it with its
+ * buddy for as long as the buddy is free and whole.
+ */
+int bd_free(BuddyAllocator *allocator, long blockBaseAddress);
+
+/*
+ * Changes the allocation at blockBaseAddress to newSize blocks if its
+ * block still holds newSize and no smaller order would, so nothing has
+ * to split or merge. Returns BD_ERR_NO_CONTIGUOUS otherwise, leaving
+ * the allocation as it was.
+ */
+int bd_resize(BuddyAllocator *allocator, long blockBaseAddress, long newSize);
+
+/*
+ * Calls mapFunc with the first and last block of every free (isFree
+ * non-zero) or used block, in address order.
+ */
+void bd_mapBlocks(BuddyAllocator *allocator, int isFree, void *mapParam, void (mapFunc)(long, long, void *));
+
+#endif
@@ -0,0 +1,1035 @@
+//
+//  fml.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/7/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+#include "fml.h"
+
+const char *fmlPolicyNames[FML_POLICY_COUNT] = {"bestfit", "firstfit", "nextfit", "worstfit", "buddy", "bitmap"};
+
+static int sortComparator(LinkedListEntry *context[],void *newData) {
+    int retval = LL_SORT_DO_NOT_INSERT_YET;
+    LinkedListEntry *nextentry = context[LL_SORT_CONTEXT_NEXT];
+    LinkedListEntry *currententry = context[LL_SORT_CONTEXT_CURRENT];
+    
+    pageDef *currentPage = LL_CONTAINER_OF(currententry, pageDef, link);
+    pageDef *nextPage = (nextentry == NULL?NULL:LL_CONTAINER_OF(nextentry, pageDef, link));
+    pageDef *newPage = newData;
+    
+    
+    if(newPage->start<currentPage->start) {
+        retval = LL_SORT_INSERT_BEFORE_CURRENT;
+    } else if(newPage->start > currentPage->start) {
+        if(nextPage==NULL || newPage->start < nextPage->start) {
+            retval = LL_SORT_INSERT_AFTER_CURRENT;
+        }
+    }
+    
+//    if((int) newData < (int) currententry->data) {
+//        if(previousentry==NULL || (int) newData > (int) previousentry->data) {
+//            return LL_SORT_INSERT_BEFORE_CURRENT;
+//        }
+//    } else if((int) newData > (int) currententry->data) {
+//        return LL_SORT_INSERT_AFTER_CURRENT;
+//    }
+    
+    return retval;
+}
+
+
+static void indexFreePage(fmlArena *arena, pageDef *page) {
+    si_insert(&arena->freeSizes, &page->sizeNode, page->start, (page->end-page->start)+1);
+}
+
+static void unindexFreePage(fmlArena *arena, pageDef *page) {
+    si_remove(&arena->freeSizes, &page->sizeNode);
+}
+
+/*
+ * Returns a zeroed pageDef, with a record of its own in a persistent
+ * arena, or NULL if either cannot be had.
+ */
+static pageDef *newPageDef(fmlArena *arena) {
+    pageDef *page = slab_alloc(&arena->pages);
+    if(page!=NULL) {
+        memset(page, 0, sizeof(*page));
+        if(fs_isOpen(&arena->store) && (page->record=fs_allocRecord(&arena->store))==FS_NO_RECORD) {
+            slab_free(page);
+            page = NULL;
+        }
+    }
+    return page;
+}
+
+static void releasePage(fmlArena *arena, pageDef *page) {
+    if(fs_isOpen(&arena->store)) {
+        fs_releaseRecord(&arena->store, page->record);
+    }
+    slab_free(page);
+}
+
+/*
+ * Copies page's bounds, state and physical links into its record.
+ */
+static void storePage(fmlArena *arena, pageDef *page) {
+    ExtentRecord *record;
+    if(page!=NULL && fs_isOpen(&arena->store)) {
+        record = fs_record(&arena->store, page->record);
+        record->start = page->start;
+        record->end = page->end;
+        record->isFree = page->isFree;
+        record->previous = (page->previousBlock==NULL ? FS_NO_RECORD : page->previousBlock->record);
+        record->next = (page->nextBlock==NULL ? FS_NO_RECORD : page->nextBlock->record);
+        if(page->previousBlock==NULL) {
+            arena->store.header->first = page->record;
+        }
+    }
+}
+
+/*
+ * Splitting or merging a block only changes links next to the block
+ * that results, so storing it and its neighbours is enough.
+ */
+static void storeBlocksAround(fmlArena *arena, pageDef *page) {
+    storePage(arena, page->previousBlock);
+    storePage(arena, page);
+    storePage(arena, page->nextBlock);
+}
+
+/*
+ * Places newPage immediately before page in the physical block chain.
+ */
+static void linkBlockBefore(pageDef *newPage, pageDef *page) {
+    newPage->previousBlock=page->previousBlock;
+    newPage->nextBlock=page;
+    if(page->previousBlock!=NULL) {
+        page->previousBlock->nextBlock=newPage;
+    }
+    page->previousBlock=newPage;
+}
+
+/*
+ * Places newPage immediately after page in the physical block chain.
+ */
+static void linkBlockAfter(pageDef *newPage, pageDef *page) {
+    newPage->previousBlock=page;
+    newPage->nextBlock=page->nextBlock;
+    if(page->nextBlock!=NULL) {
+        page->nextBlock->previousBlock=newPage;
+    }
+    page->nextBlock=newPage;
+}
+
+static void unlinkBlock(pageDef *page) {
+    if(page->previousBlock!=NULL) {
+        page->previousBlock->nextBlock=page->nextBlock;
+    }
+    if(page->nextBlock!=NULL) {
+        page->nextBlock->previousBlock=page->previousBlock;
+    }
+    page->previousBlock=page->nextBlock=NULL;
+}
+
+/*
+ * Moves page from whichever list it is on to the other one, reusing the
+ * pageDef rather than copying it.
+ */
+static void moveBlock(fmlArena *arena, pageDef *page, int toFree) {
+    ll_remove(&page->link, NULL);
+    page->isFree=toFree;
+    ll_appendEntry(toFree ? arena->freeList : arena->usedList, &page->link, page);
+}
+
+int lookupPolicy(const char *name) {
+    int retval;
+    for(retval=FML_POLICY_COUNT-1;retval>=0 && strcmp(name, fmlPolicyNames[retval])!=0;retval--) {
+        //Empty loop
+    }
+    return retval;
+}
+
+/*
+ * Every pageDef lives in arena->pages and its list entry is embedded, so
+ * the lists only need detaching before the pages go back in one step.
+ */
+static void resetExtents(fmlArena *arena) {
+    if(arena->freeList!=NULL) {
+        ll_destroy(arena->freeList, NULL);
+        arena->freeList=NULL;
+    }
+    
+    if(arena->usedList!=NULL) {
+        ll_destroy(arena->usedList, NULL);
+        arena->usedList=NULL;
+    }
+    
+    si_clear(&arena->freeSizes);
+    ah_clear(&arena->usedStarts);
+    slab_releaseAll(&arena->pages);
+}
+
+/*
+ * Creates the empty lists and indexes an extent policy works from.
+ */
+static void createExtents(fmlArena *arena) {
+    int policy = arena->policy;
+    si_initialize(&arena->freeSizes,
+                  (policy==FML_POLICY_FIRSTFIT || policy==FML_POLICY_NEXTFIT) ? SI_ORDER_START : SI_ORDER_SIZE);
+    arena->freeList = ll_create();
+    ll_assignSortFunction(arena->freeList, sortComparator);
+    ll_enableSkipList(arena->freeList);
+    arena->usedList = ll_create();
+    ll_assignSortFunction(arena->usedList, sortComparator);
+    ll_enableSkipList(arena->usedList);
+    
+    if(arena->pages.objectSize==0) {
+        slab_initialize(&arena->pages, sizeof(pageDef));
+    }
+}
+
+int initializeFml(fmlArena *arena,long blockCount,int policy) {
+    int retval = FML_SUCCESS;
+    pageDef *page;
+    
+    if(fs_isOpen(&arena->store) && (policy==FML_POLICY_BUDDY || policy==FML_POLICY_BITMAP)) {
+        retval = FML_ERR_UNSUPPORTED_POLICY;
+    } else if(blockCount<0 || blockCount>FML_MAX_BLOCKS) {
+        retval = FML_ERR_BAD_SIZE;
+    } else {
+        resetExtents(arena);
+        bd_destroy(&arena->buddy);
+        bm_destroy(&arena->bitmap);
+        arena->policy = policy;
+        arena->nextFitCursor = 0;
+        
+        if(policy==FML_POLICY_BUDDY) {
+            if(bd_initialize(&arena->buddy, blockCount)!=BD_SUCCESS) {
+                retval = FML_ERR_ALLOCATION_FAILED;
+            }
+        } else if(policy==FML_POLICY_BITMAP) {
+            if(bm_initialize(&arena->bitmap, blockCount)!=BM_SUCCESS) {
+                retval = FML_ERR_ALLOCATION_FAILED;
+            }
+        } else {
+            createExtents(arena);
+            if(fs_isOpen(&arena->store)) {
+                fs_reset(&arena->store, blockCount, policy);
+            }
+            
+            if((page = newPageDef(arena))==NULL) {
+                retval = FML_ERR_ALLOCATION_FAILED;
+            } else {
+                page->start=0;
+                page->end=blockCount-1;
+                page->isFree=1;
+                ll_appendEntry(arena->freeList, &page->link, page);
+                indexFreePage(arena, page);
+                storePage(arena, page);
+            }
+        }
+    }
+    return retval;
+}
+
+/*
+ * Rebuilds the pages, lists and indexes from the store's chain, which
+ * fs_check has already validated. Pages are made in address order, so
+ * each list is filled by one ll_insertEntryBatch: free pages collect at
+ * the front of pages and used ones at the back, reversed, until the walk
+ * ends.
+ */
+static int restoreExtents(fmlArena *arena) {
+    int retval = FS_SUCCESS;
+    ExtentStore *store = &arena->store;
+    long count = store->header->recordCount;
+    long freeCount = 0;
+    long usedFrom = count;
+    long index;
+    long i;
+    pageDef **pages;
+    pageDef *page;
+    pageDef *previousPage = NULL;
+    ExtentRecord *record;
+    LinkedListEntry **entries;
+    
+    arena->policy = (int) store->header->policy;
+    arena->nextFitCursor = store->header->nextFitCursor;
+    createExtents(arena);
+    
+    pages = malloc(count*(sizeof(*pages)+sizeof(*entries)));
+    entries = (LinkedListEntry **) (pages+count);
+    for(index=store->header->first;pages!=NULL && index!=FS_NO_RECORD;index=record->next) {
+        record = fs_record(store, index);
+        if((page=slab_alloc(&arena->pages))==NULL) {
+            break;
+        }
+        memset(page, 0, sizeof(*page));
+        page->start = record->start;
+        page->end = record->end;
+        page->isFree = (int) record->isFree;
+        page->record = index;
+        page->previousBlock = previousPage;
+        if(previousPage!=NULL) {
+            previousPage->nextBlock = page;
+        }
+        previousPage = page;
+        if(page->isFree) {
+            pages[freeCount++] = page;
+        } else {
+            pages[--usedFrom] = page;
+        }
+    }
+    
+    if(pages==NULL || index!=FS_NO_RECORD) {
+        retval = FS_ERR_ALLOCATION_FAILED;
+        resetExtents(arena);
+        fs_close(store);
+    } else {
+        for(i=0;i<(count-usedFrom)/2;i++) {
+            page = pages[usedFrom+i];
+            pages[usedFrom+i] = pages[count-1-i];
+            pages[count-1-i] = page;
+        }
+        ah_destroy(&arena->usedStarts);
+        ah_initialize(&arena->usedStarts, count-usedFrom);
+        for(i=0;i<count;i++) {
+            entries[i] = &pages[i]->link;
+            if(pages[i]->isFree) {
+                indexFreePage(arena, pages[i]);
+            } else {
+                ah_put(&arena->usedStarts, pages[i]->start, entries[i]);
+            }
+        }
+        ll_insertEntryBatch(arena->freeList, entries, (void **) pages, freeCount);
+        ll_insertEntryBatch(arena->usedList, entries+freeCount, (void **) (pages+freeCount), count-freeCount);
+    }
+    free(pages);
+    return retval;
+}
+
+int openFml(fmlArena *arena, const char *path, long blockCount, int policy) {
+    int retval;
+    int created;
+    ExtentStoreHeader *header;
+    
+    destroyFml(arena);
+    if(policy==FML_POLICY_BUDDY || policy==FML_POLICY_BITMAP) {
+        retval = FS_ERR_UNSUPPORTED_POLICY;
+    } else if(blockCount<0 || blockCount>FML_MAX_BLOCKS) {
+        retval = FS_ERR_BAD_SIZE;
+    } else if((retval = fs_open(&arena->store, path, &created))==FS_SUCCESS) {
+        header = arena->store.header;
+        if(created || header->first==FS_NO_RECORD) {
+            if(initializeFml(arena, blockCount, policy)!=FML_SUCCESS) {
+                retval = FS_ERR_ALLOCATION_FAILED;
+                destroyFml(arena);
+            }
+        } else if(header->policy<0 || header->policy>=FML_POLICY_COUNT ||
+                  header->policy==FML_POLICY_BUDDY || header->policy==FML_POLICY_BITMAP) {
+            retval = FS_ERR_BAD_FORMAT;
+            fs_close(&arena->store);
+        } else {
+            retval = restoreExtents(arena);
+        }
+    }
+    return retval;
+}
+
+void destroyFml(fmlArena *arena) {
+    resetExtents(arena);
+    fs_close(&arena->store);
+    ah_destroy(&arena->usedStarts);
+    bd_destroy(&arena->buddy);
+    bm_destroy(&arena->bitmap);
+}
+
+/*
+ * Picks the free extent for a request of requestedSize blocks:
+ * bestfit takes the smallest that fits, worstfit the largest, firstfit
+ * the lowest-addressed, and nextfit the lowest-addressed at or after
+ * the end of the previous allocation, wrapping to the start of the
+ * arena. Size ties go to the lowest address.
+ */
+static SizeIndexNode *placeRequest(fmlArena *arena, long requestedSize) {
+    SizeIndexNode *node;
+    switch(arena->policy) {
+        case FML_POLICY_FIRSTFIT:
+            node = si_findLowestAtLeast(&arena->freeSizes, requestedSize);
+            break;
+        case FML_POLICY_NEXTFIT:
+            node = si_findLowestAtLeastFrom(&arena->freeSizes, arena->nextFitCursor, requestedSize);
+            if(node==NULL) {
+                node = si_findLowestAtLeast(&arena->freeSizes, requestedSize);
+            }
+            break;
+        case FML_POLICY_WORSTFIT:
+            node = si_findLargest(&arena->freeSizes);
+            if(node!=NULL && node->size < requestedSize) {
+                node = NULL;
+            }
+            break;
+        case FML_POLICY_BESTFIT:
+        default:
+            node = si_findSmallestAtLeast(&arena->freeSizes, requestedSize);
+    }
+    return node;
+}
+
+/*
+ * As placeRequest, for a block that must start at a multiple of
+ * alignment. worstfit takes the largest extent with room for it.
+ */
+static SizeIndexNode *placeAlignedRequest(fmlArena *arena, long requestedSize, long alignment) {
+    SizeIndexNode *node;
+    switch(arena->policy) {
+        case FML_POLICY_FIRSTFIT:
+            node = si_findLowestAlignedAtLeastFrom(&arena->freeSizes, 0, requestedSize, alignment);
+            break;
+        case FML_POLICY_NEXTFIT:
+            node = si_findLowestAlignedAtLeastFrom(&arena->freeSizes, arena->nextFitCursor, requestedSize, alignment);
+            if(node==NULL) {
+                node = si_findLowestAlignedAtLeastFrom(&arena->freeSizes, 0, requestedSize, alignment);
+            }
+            break;
+        case FML_POLICY_WORSTFIT:
+            node = si_findLargestAligned(&arena->freeSizes, requestedSize, alignment);
+            break;
+        case FML_POLICY_BESTFIT:
+        default:
+            node = si_findSmallestAlignedAtLeast(&arena->freeSizes, requestedSize, alignment);
+    }
+    return node;
+}
+
+/*
+ * Turns blocks start..start+size-1 of the free extent page into a used
+ * block, leaving whatever is on either side free. page keeps the part
+ * before the block if there is one and otherwise the part after it, so
+ * an exact fit turns page itself into the used block and no split needs
+ * more than two new pageDefs. Both are had before anything changes, so
+ * running out leaves the extent as it was. freeList only gains the
+ * trailing part of a three-way split, which sorts straight after page;
+ * that split also relinks the block after it, which is stored too.
+ */
+static int carveExtent(fmlArena *arena, pageDef *page, long start, long size) {
+    int retval = 1;
+    long end = start+size-1;
+    int hasLead = (start>page->start);
+    int hasTrail = (end<page->end);
+    pageDef *usedPage = page;
+    pageDef *trailPage = NULL;
+    
+    if((hasLead || hasTrail) && (usedPage=newPageDef(arena))==NULL) {
+        retval = 0;
+    } else if(hasLead && hasTrail && (trailPage=newPageDef(arena))==NULL) {
+        releasePage(arena, usedPage);
+        retval = 0;
+    } else {
+        unindexFreePage(arena, page);
+        if(usedPage==page) {
+            moveBlock(arena, page, 0);
+        } else {
+            usedPage->start=start;
+            usedPage->end=end;
+            usedPage->isFree=0;
+            if(hasLead) {
+                linkBlockAfter(usedPage, page);
+            } else {
+                linkBlockBefore(usedPage, page);
+            }
+            ll_appendEntry(arena->usedList, &usedPage->link, usedPage);
+            
+            if(trailPage!=NULL) {
+                trailPage->start=end+1;
+                trailPage->end=page->end;
+                trailPage->isFree=1;
+                linkBlockAfter(trailPage, usedPage);
+                ll_appendEntry(arena->freeList, &trailPage->link, trailPage);
+                indexFreePage(arena, trailPage);
+            }
+            if(hasLead) {
+                page->end=start-1;
+            } else {
+                page->start=end+1;
+            }
+            indexFreePage(arena, page);
+        }
+        ah_put(&arena->usedStarts, start, &usedPage->link);
+        storeBlocksAround(arena, usedPage);
+        if(trailPage!=NULL) {
+            storePage(arena, trailPage->nextBlock);
+        }
+    }
+    return retval;
+}
+
+/*
+ * Carves the allocation from the extent the policy picks, at the
+ * extent's start or, for an alignment above 1, at the first multiple of
+ * it inside the extent.
+ */
+static int extentAllocate(fmlArena *arena, long requestedSize, long alignment, long *acquiredAddress) {
+    int retval = 0;
+    long start;
+    pageDef *page;
+    SizeIndexNode *node = (alignment>1 ? placeAlignedRequest(arena, requestedSize, alignment)
+                                       : placeRequest(arena, requestedSize));
+    
+    if(node!=NULL) {
+        page=SI_CONTAINER_OF(node, pageDef, sizeNode);
+        start=(page->start+alignment-1) & ~(alignment-1);
+        if(carveExtent(arena, page, start, requestedSize)) {
+            *acquiredAddress=start;
+            arena->nextFitCursor=start+requestedSize;
+            if(fs_isOpen(&arena->store)) {
+                arena->store.header->nextFitCursor=arena->nextFitCursor;
+            }
+            retval = 1;
+        }
+    }
+    return retval;
+}
+
+/*
+ * Returns the block at blockBaseAddress to the free list. The boundary
+ * tags give both physical neighbours directly, so merging with a free
+ * neighbour only adjusts that neighbour's bounds in place; freeList
+ * order is unaffected because no other free extent can lie between
+ * them.
+ */
+static int extentFree(fmlArena *arena, long blockBaseAddress) {
+    int retval = 1;
+    pageDef *usedPage;
+    pageDef *previousPage;
+    pageDef *nextPage;
+    LinkedListEntry *entryToDeallocate = ah_remove(&arena->usedStarts, blockBaseAddress);
+    
+    if(entryToDeallocate!=NULL) {
+        usedPage=LL_CONTAINER_OF(entryToDeallocate, pageDef, link);
+        previousPage=usedPage->previousBlock;
+        nextPage=usedPage->nextBlock;
+        
+        if(previousPage!=NULL && previousPage->isFree) {
+            unindexFreePage(arena, previousPage);
+            previousPage->end=usedPage->end;
+            unlinkBlock(usedPage);
+            ll_remove(entryToDeallocate, NULL);
+            releasePage(arena, usedPage);
+            usedPage=previousPage;
+        } else if(nextPage!=NULL && nextPage->isFree) {
+            unindexFreePage(arena, nextPage);
+            nextPage->start=usedPage->start;
+            unlinkBlock(usedPage);
+            ll_remove(entryToDeallocate, NULL);
+            releasePage(arena, usedPage);
+            usedPage=nextPage;
+            nextPage=NULL;
+        } else {
+            moveBlock(arena, usedPage, 1);
+        }
+        
+        if(nextPage!=NULL && nextPage->isFree) {
+            unindexFreePage(arena, nextPage);
+            usedPage->end=nextPage->end;
+            unlinkBlock(nextPage);
+            ll_remove(&nextPage->link, NULL);
+            releasePage(arena, nextPage);
+        }
+        
+        indexFreePage(arena, usedPage);
+        storeBlocksAround(arena, usedPage);
+    }else {
+        retval = 0;
+    }
+    
+    return retval;
+}
+
+/*
+ * Resizes the used extent page to newSize blocks without moving it. A
+ * shrink gives the tail to the free extent after page, which just
+ * starts earlier, or to a new free extent if page is followed by a used
+ * block or the end of the arena. A grow takes the blocks from the front
+ * of the free extent after page, which disappears if they are all of
+ * it. Either way freeList keeps its order, since no other free extent
+ * lies between the two. Returns 0 if a grow does not fit.
+ */
+static int extentResizeInPlace(fmlArena *arena, pageDef *page, long newSize) {
+    int retval = 1;
+    long newEnd = page->start+newSize-1;
+    pageDef *nextPage = page->nextBlock;
+    pageDef *tail;
+    
+    if(newEnd<page->end) {
+        if(nextPage!=NULL && nextPage->isFree) {
+            unindexFreePage(arena, nextPage);
+            nextPage->start=newEnd+1;
+            page->end=newEnd;
+            indexFreePage(arena, nextPage);
+            storeBlocksAround(arena, page);
+        } else if((tail=newPageDef(arena))!=NULL) {
+            tail->start=newEnd+1;
+            tail->end=page->end;
+            tail->isFree=1;
+            page->end=newEnd;
+            linkBlockAfter(tail, page);
+            ll_appendEntry(arena->freeList, &tail->link, tail);
+            indexFreePage(arena, tail);
+            storeBlocksAround(arena, tail);
+        } else {
+            retval = 0;
+        }
+    } else if(newEnd>page->end) {
+        if(nextPage==NULL || !nextPage->isFree || nextPage->end<newEnd) {
+            retval = 0;
+        } else {
+            unindexFreePage(arena, nextPage);
+            if(nextPage->end==newEnd) {
+                unlinkBlock(nextPage);
+                ll_remove(&nextPage->link, NULL);
+                releasePage(arena, nextPage);
+            } else {
+                nextPage->start=newEnd+1;
+                indexFreePage(arena, nextPage);
+            }
+            page->end=newEnd;
+            storeBlocksAround(arena, page);
+        }
+    }
+    return retval;
+}
+
+static int comparePageStarts(const void *a, const void *b) {
+    long first=(*(pageDef * const *)a)->start;
+    long second=(*(pageDef * const *)b)->start;
+    return (first>second) - (first<second);
+}
+
+/*
+ * Frees every resolved page in pages, which holds count used pages in
+ * address order, and returns the resulting free extents to freeList in
+ * one ll_insertEntryBatch merge; entries is scratch space for as many
+ * entries. Walking in address order means a
+ * page's lower neighbour, if free, is either an extent already on
+ * freeList or a survivor of this batch; the former is taken off
+ * freeList and becomes a survivor itself. An upper neighbour that is
+ * free can only be an existing extent and is absorbed directly.
+ */
+static void extentFreeSorted(fmlArena *arena, pageDef *pages[], LinkedListEntry *entries[], long count) {
+    pageDef *page;
+    pageDef *previousPage;
+    pageDef *nextPage;
+    long survivors=0;
+    long i;
+    
+    for(i=0;i<count;i++) {
+        page=pages[i];
+        ll_remove(&page->link, NULL);
+        page->isFree=1;
+        
+        previousPage=page->previousBlock;
+        if(previousPage!=NULL && previousPage->isFree) {
+            if(previousPage->link.owner!=NULL) {
+                unindexFreePage(arena, previousPage);
+                ll_remove(&previousPage->link, NULL);
+                pages[survivors++]=previousPage;
+            }
+            previousPage->end=page->end;
+            unlinkBlock(page);
+            releasePage(arena, page);
+            page=previousPage;
+        } else {
+            pages[survivors++]=page;
+        }
+        
+        nextPage=page->nextBlock;
+        if(nextPage!=NULL && nextPage->isFree) {
+            unindexFreePage(arena, nextPage);
+            page->end=nextPage->end;
+            unlinkBlock(nextPage);
+            ll_remove(&nextPage->link, NULL);
+            releasePage(arena, nextPage);
+        }
+        storeBlocksAround(arena, page);
+    }
+    
+    /* pages now holds the survivors, still in address order */
+    for(i=0;i<survivors;i++) {
+        indexFreePage(arena, pages[i]);
+        entries[i]=&pages[i]->link;
+    }
+    ll_insertEntryBatch(arena->freeList, entries, (void **) pages, survivors);
+}
+
+long fmlNanos() {
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+    if(timebase.denom==0) {
+        mach_timebase_info(&timebase);
+    }
+    return (long) (mach_absolute_time() * timebase.numer / timebase.denom);
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long) now.tv_sec*1000000000L + now.tv_nsec;
+#endif
+}
+
+#ifdef FML_STATS
+static void recordLatency(fmlLatencyHistogram *histogram, long nanos, int succeeded) {
+    int bucket = 0;
+    while(bucket<FML_LATENCY_BUCKETS-1 && (nanos >> (bucket+1))!=0) {
+        bucket++;
+    }
+    histogram->buckets[bucket]++;
+    histogram->calls++;
+    histogram->totalNanos+=nanos;
+    if(nanos>histogram->maxNanos) {
+        histogram->maxNanos=nanos;
+    }
+    if(!succeeded) {
+        histogram->failures++;
+    }
+}
+#endif
+
+static int allocateBlocks(fmlArena *arena, long requestedSize, long alignment, long *acquiredAddress) {
+    int retval;
+    if(arena->policy==FML_POLICY_BUDDY) {
+        retval = (bd_allocateAligned(&arena->buddy, requestedSize, alignment, acquiredAddress)==BD_SUCCESS);
+    } else if(arena->policy==FML_POLICY_BITMAP) {
+        retval = (bm_allocateAligned(&arena->bitmap, requestedSize, alignment, acquiredAddress)==BM_SUCCESS);
+    } else {
+        retval = extentAllocate(arena, requestedSize, alignment, acquiredAddress);
+    }
+    return retval;
+}
+
+static int freeBlocks(fmlArena *arena, long blockBaseAddress) {
+    int retval;
+    if(arena->policy==FML_POLICY_BUDDY) {
+        retval = (bd_free(&arena->buddy, blockBaseAddress)==BD_SUCCESS);
+    } else if(arena->policy==FML_POLICY_BITMAP) {
+        retval = (bm_free(&arena->bitmap, blockBaseAddress)==BM_SUCCESS);
+    } else {
+        retval = extentFree(arena, blockBaseAddress);
+    }
+    return retval;
+}
+
+int performAllocation(fmlArena *arena, long requestedSize, long *acquiredAddress) {
+    int retval;
+#ifdef FML_STATS
+    long started = fmlNanos();
+#endif
+    retval = allocateBlocks(arena, requestedSize, 1, acquiredAddress);
+#ifdef FML_STATS
+    recordLatency(&arena->stats.allocate, fmlNanos()-started, retval);
+#endif
+    return retval;
+}
+
+int performAlignedAllocation(fmlArena *arena, long requestedSize, long alignment, long *acquiredAddress) {
+    int retval = 0;
+#ifdef FML_STATS
+    long started = fmlNanos();
+#endif
+    if(requestedSize>0 && alignment>0 && (alignment & (alignment-1))==0) {
+        retval = allocateBlocks(arena, requestedSize, alignment, acquiredAddress);
+    }
+#ifdef FML_STATS
+    recordLatency(&arena->stats.allocate, fmlNanos()-started, retval);
+#endif
+    return retval;
+}
+
+int performFree(fmlArena *arena, long blockBaseAddress) {
+    int retval;
+#ifdef FML_STATS
+    long started = fmlNanos();
+#endif
+    retval = freeBlocks(arena, blockBaseAddress);
+#ifdef FML_STATS
+    recordLatency(&arena->stats.free, fmlNanos()-started, retval);
+#endif
+    return retval;
+}
+
+int performResize(fmlArena *arena, long blockBaseAddress, long newSize, long *newAddress) {
+    int retval = 0;
+    LinkedListEntry *entry;
+#ifdef FML_STATS
+    long started = fmlNanos();
+#endif
+    
+    if(newSize>0 && allocationBlocks(arena, blockBaseAddress)>0) {
+        if(arena->policy==FML_POLICY_BUDDY) {
+            retval = (bd_resize(&arena->buddy, blockBaseAddress, newSize)==BD_SUCCESS);
+        } else if(arena->policy==FML_POLICY_BITMAP) {
+            retval = (bm_resize(&arena->bitmap, blockBaseAddress, newSize)==BM_SUCCESS);
+        } else {
+            entry = ah_get(&arena->usedStarts, blockBaseAddress);
+            retval = extentResizeInPlace(arena, LL_CONTAINER_OF(entry, pageDef, link), newSize);
+        }
+        
+        if(retval) {
+            *newAddress = blockBaseAddress;
+        } else if(allocateBlocks(arena, newSize, 1, newAddress)) {
+            freeBlocks(arena, blockBaseAddress);
+            retval = 1;
+        }
+    }
+#ifdef FML_STATS
+    recordLatency(&arena->stats.resize, fmlNanos()-started, retval);
+#endif
+    return retval;
+}
+
+long performFreeBatch(fmlArena *arena, long blockBaseAddresses[], long count, int results[]) {
+    long retval=0;
+    long resolved=0;
+    long i;
+    pageDef **pages;
+    LinkedListEntry **entries;
+    LinkedListEntry *entry;
+#ifdef FML_STATS
+    long started = fmlNanos();
+#endif
+    
+    if(arena->policy==FML_POLICY_BUDDY || arena->policy==FML_POLICY_BITMAP ||
+       (pages=malloc(count*(sizeof(*pages)+sizeof(*entries))))==NULL) {
+        for(i=0;i<count;i++) {
+            retval+=(results[i]=performFree(arena, blockBaseAddresses[i]));
+        }
+        return retval;
+    }
+    
+    for(i=0;i<count;i++) {
+        entry=ah_remove(&arena->usedStarts, blockBaseAddresses[i]);
+        if((results[i]=(entry!=NULL))) {
+            pages[resolved++]=LL_CONTAINER_OF(entry, pageDef, link);
+        }
+    }
+    
+    entries=(LinkedListEntry **) (pages+count);
+    qsort(pages, resolved, sizeof(*pages), comparePageStarts);
+    extentFreeSorted(arena, pages, entries, resolved);
+    free(pages);
+    retval=resolved;
+#ifdef FML_STATS
+    recordLatency(&arena->stats.free, fmlNanos()-started, retval==count);
+#endif
+    return retval;
+}
+
+long allocationBlocks(fmlArena *arena, long blockBaseAddress) {
+    long retval = 0;
+    LinkedListEntry *entry;
+    BuddyBlock *block;
+    
+    if(arena->policy==FML_POLICY_BUDDY) {
+        if((block=ah_get(&arena->buddy.blocks, blockBaseAddress))!=NULL && !block->isFree) {
+            retval = 1L << block->order;
+        }
+    } else if(arena->policy==FML_POLICY_BITMAP) {
+        retval = bm_allocationSize(&arena->bitmap, blockBaseAddress);
+    } else if((entry=ah_get(&arena->usedStarts, blockBaseAddress))!=NULL) {
+        retval = LL_CONTAINER_OF(entry, pageDef, link)->end-blockBaseAddress+1;
+    }
+    return retval;
+}
+
+/*
+ * Key comparator placing a free extent against a block address: 0 if
+ * the extent contains it.
+ */
+static int compareExtentToAddress(void *data, void *key) {
+    pageDef *page = data;
+    long address = *(long *) key;
+    return (page->end < address) ? -1 : (page->start > address);
+}
+
+/*
+ * A buddy block of order k starts at a multiple of 2^k, so the block
+ * holding address is the one whose order matches the alignment its
+ * start was looked up at.
+ */
+static int buddyFreeRun(BuddyAllocator *buddy, long address, long *runStart, long *runEnd) {
+    int retval = 0;
+    int order;
+    BuddyBlock *block = NULL;
+    
+    for(order=0;order<buddy->orderCount && block==NULL;order++) {
+        block = ah_get(&buddy->blocks, address & ~((1L << order)-1));
+        if(block!=NULL && block->order!=order) {
+            block = NULL;
+        }
+    }
+    if(block!=NULL && block->isFree) {
+        *runStart = block->start;
+        *runEnd = block->start+(1L << block->order)-1;
+        retval = 1;
+    }
+    return retval;
+}
+
+int findFreeRun(fmlArena *arena, long address, long *runStart, long *runEnd) {
+    int retval = 0;
+    LinkedListEntry *entry;
+    pageDef *page;
+    
+    if(arena->policy==FML_POLICY_BUDDY) {
+        retval = buddyFreeRun(&arena->buddy, address, runStart, runEnd);
+    } else if(arena->policy==FML_POLICY_BITMAP) {
+        retval = (bm_freeRun(&arena->bitmap, address, runStart, runEnd)==BM_SUCCESS);
+    } else if(arena->freeList!=NULL &&
+              (entry=ll_searchSorted(arena->freeList, &address, compareExtentToAddress))!=NULL) {
+        page = LL_CONTAINER_OF(entry, pageDef, link);
+        *runStart = page->start;
+        *runEnd = page->end;
+        retval = 1;
+    }
+    return retval;
+}
+
+void mapFmlBlocks(fmlArena *arena, int isFree, void *mapParam, void (mapFunc)(long, long, void *)) {
+    LinkedListEntry *entry;
+    pageDef *page;
+    
+    if(arena->policy==FML_POLICY_BUDDY) {
+        bd_mapBlocks(&arena->buddy, isFree, mapParam, mapFunc);
+    } else if(arena->policy==FML_POLICY_BITMAP) {
+        bm_mapBlocks(&arena->bitmap, isFree, mapParam, mapFunc);
+    } else if(arena->freeList!=NULL) {
+        entry = (isFree ? arena->freeList : arena->usedList)->first;
+        for(;entry!=NULL;entry=entry->next) {
+            page = LL_CONTAINER_OF(entry, pageDef, link);
+            mapFunc(page->start, page->end, mapParam);
+        }
+    }
+}
+
+static void summarizeFreeRun(long start, long end, void *param) {
+    long *summary = param;
+    summary[0]++;
+    if(end-start+1 > summary[1]) {
+        summary[1] = end-start+1;
+    }
+}
+
+/*
+ * The bitmap backend keeps no per-run state, so its summary walks the
+ * whole map.
+ */
+void summarizeFreeBlocks(fmlArena *arena, long *freeBlockCount, long *largestFreeBlock) {
+    SizeIndexNode *node;
+    int order;
+    long summary[2] = {0, 0};
+    
+    *freeBlockCount = 0;
+    *largestFreeBlock = 0;
+    if(arena->policy==FML_POLICY_BITMAP) {
+        bm_mapBlocks(&arena->bitmap, 1, summary, summarizeFreeRun);
+        *freeBlockCount = summary[0];
+        *largestFreeBlock = summary[1];
+    } else if(arena->policy==FML_POLICY_BUDDY) {
+        for(order=0;order<arena->buddy.orderCount;order++) {
+            if(arena->buddy.freeLists[order]->nodeCount>0) {
+                *freeBlockCount += arena->buddy.freeLists[order]->nodeCount;
+                *largestFreeBlock = 1L << order;
+            }
+        }
+    } else if(arena->freeList!=NULL) {
+        *freeBlockCount = arena->freeList->nodeCount;
+        node = si_findLargest(&arena->freeSizes);
+        if(node!=NULL) {
+            *largestFreeBlock = node->size;
+        }
+    }
+}
+
+static void countBlock(long start, long end, void *param) {
+    (void) start;
+    (void) end;
+    (*(long *) param)++;
+}
+
+#ifdef FML_STATS
+/*
+ * Percentiles are read off the histogram, so each is only known to
+ * within its bucket and is reported as the bucket's upper bound.
+ */
+static long histogramPercentile(fmlLatencyHistogram *histogram, double percentile) {
+    long wanted = (long) (percentile/100.0*histogram->calls + 0.5);
+    long seen = 0;
+    int bucket;
+    for(bucket=0;bucket<FML_LATENCY_BUCKETS-1;bucket++) {
+        seen+=histogram->buckets[bucket];
+        if(seen>=wanted && seen>0) {
+            break;
+        }
+    }
+    return (2L << bucket)-1;
+}
+
+static void printHistogram(const char *name, fmlLatencyHistogram *histogram, FILE *out) {
+    int bucket;
+    fprintf(out, "%s: %li calls, %li failed", name, histogram->calls, histogram->failures);
+    if(histogram->calls>0) {
+        fprintf(out, ", mean %lins, p50 <=%lins, p99 <=%lins, max %lins",
+                histogram->totalNanos/histogram->calls,
+                histogramPercentile(histogram, 50), histogramPercentile(histogram, 99),
+                histogram->maxNanos);
+    }
+    fprintf(out, "\n");
+    for(bucket=0;bucket<FML_LATENCY_BUCKETS;bucket++) {
+        if(histogram->buckets[bucket]>0) {
+            fprintf(out, "  %12li-%lins %li\n", bucket==0 ? 0L : 1L << bucket, (2L << bucket)-1, histogram->buckets[bucket]);
+        }
+    }
+}
+#endif
+
+void printFmlStats(fmlArena *arena, FILE *out) {
+    long freeBlocks = 0;
+    long usedBlocks = 0;
+#ifdef LL_STATS
+    LinkedListStats stats;
+#endif
+    
+    mapFmlBlocks(arena, 1, &freeBlocks, countBlock);
+    mapFmlBlocks(arena, 0, &usedBlocks, countBlock);
+    fprintf(out, "Arena: %s, %li free blocks, %li used blocks\n", fmlPolicyNames[arena->policy], freeBlocks, usedBlocks);
+    
+#ifdef FML_STATS
+    printHistogram("allocate", &arena->stats.allocate, out);
+    printHistogram("free", &arena->stats.free, out);
+    printHistogram("resize", &arena->stats.resize, out);
+#endif
+    
+#ifdef LL_STATS
+    ll_getStats(&stats);
+    fprintf(out, "Lists: %li searches (%.1f visits each), %li sorted inserts (%.1f visits each), %li comparator calls\n",
+            stats.searches, stats.searches>0 ? (double) stats.searchVisits/stats.searches : 0.0,
+            stats.inserts, stats.inserts>0 ? (double) stats.insertVisits/stats.inserts : 0.0,
+            stats.compareCalls);
+    fprintf(out, "Entries: %li allocated, %li released, pool hit rate %.1f%% (%li hits, %li misses)\n",
+            stats.entryAllocs, stats.entryReleases,
+            stats.poolHits+stats.poolMisses>0 ? 100.0*stats.poolHits/(stats.poolHits+stats.poolMisses) : 0.0,
+            stats.poolHits, stats.poolMisses);
+#endif
+    
+#if !defined(FML_STATS) && !defined(LL_STATS)
+    fprintf(out, "Latency and list counters are not built in; rebuild with FML_STATS and LL_STATS.\n");
+#endif
+    fprintf(out, "\n");
+}
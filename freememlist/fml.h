@@ -0,0 +1,265 @@
+//
+//  fml.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/7/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_fml_h
+#define freememlist_fml_h
+
+#include <stdio.h>
+#include "llist.h"
+#include "sizeindex.h"
+#include "addresshash.h"
+#include "slab.h"
+#include "buddy.h"
+#include "bitmap.h"
+#include "fmlstore.h"
+
+/*
+ * Placement policies, chosen per arena at init. Best-fit and worst-fit
+ * keep freeSizes ordered by size; first-fit and next-fit keep it ordered
+ * by address, relying on its subtree maximum sizes to skip extents that
+ * are too small. FML_POLICY_BUDDY swaps the extent lists for the binary
+ * buddy backend in buddy.h, which rounds every allocation up to a power
+ * of two, and FML_POLICY_BITMAP for the first-fit bitmap backend in
+ * bitmap.h.
+ *
+ * Block addresses and counts are longs throughout, 64 bits on every
+ * target this builds for. The extent policies hold one pageDef per
+ * extent, indexed by address and size, so their memory follows the
+ * number of extents and not blockCount: a sparse space of 2^40 blocks
+ * costs what a small one with the same extents does. The buddy backend
+ * adds only a list per order, but the bitmap holds a bit per block and
+ * only suits dense spaces.
+ */
+#define FML_POLICY_BESTFIT 0
+#define FML_POLICY_FIRSTFIT 1
+#define FML_POLICY_NEXTFIT 2
+#define FML_POLICY_WORSTFIT 3
+#define FML_POLICY_BUDDY 4
+#define FML_POLICY_BITMAP 5
+#define FML_POLICY_COUNT 6
+
+extern const char *fmlPolicyNames[FML_POLICY_COUNT];
+
+#define FML_SUCCESS 0
+#define FML_ERR_UNSUPPORTED_POLICY 1
+#define FML_ERR_BAD_SIZE 2
+#define FML_ERR_ALLOCATION_FAILED 3
+
+/*
+ * The largest blockCount an arena takes under any policy. It leaves
+ * room to round any address up to any power-of-two alignment a long
+ * holds without overflowing.
+ */
+#define FML_MAX_BLOCKS (1L << 62)
+
+/*
+ * previousBlock and nextBlock are boundary tags: they link every extent,
+ * free or used, to its physical neighbours so coalescing never has to
+ * search a list. link is the embedded node holding the page in
+ * whichever of freeList or usedList isFree says it belongs to, so a
+ * page costs a single allocation. record is the page's ExtentRecord in
+ * a persistent arena's store.
+ */
+typedef struct pageDef pageDef;
+struct pageDef {
+    long start;
+    long end;
+    int isFree;
+    pageDef *previousBlock;
+    pageDef *nextBlock;
+    long record;
+    LinkedListEntry link;
+    SizeIndexNode sizeNode;
+};
+
+/*
+ * Building with FML_STATS times every performAllocation, performFree
+ * and performResize into a histogram of power-of-two nanosecond buckets:
+ * buckets[i] counts calls that took [2^i, 2^(i+1)) ns, with 0 and 1 ns
+ * both in bucket 0.
+ */
+#define FML_LATENCY_BUCKETS 40
+
+typedef struct fmlLatencyHistogram {
+    long calls;
+    long failures;
+    long totalNanos;
+    long maxNanos;
+    long buckets[FML_LATENCY_BUCKETS];
+} fmlLatencyHistogram;
+
+typedef struct fmlStats {
+    fmlLatencyHistogram allocate;
+    fmlLatencyHistogram free;
+    fmlLatencyHistogram resize;
+} fmlStats;
+
+/*
+ * freeList and usedList hold the extents in address order; freeSizes
+ * indexes the same free extents by size so allocation can find a block
+ * without walking freeList. Every change to a free extent's bounds must
+ * be mirrored in freeSizes. usedStarts maps the start address of every
+ * used extent to its usedList entry so free can resolve an address
+ * without walking usedList. Every pageDef is carved from pages.
+ * nextFitCursor is the address just past the last allocation, where
+ * FML_POLICY_NEXTFIT resumes its search. Under FML_POLICY_BUDDY or
+ * FML_POLICY_BITMAP only buddy or bitmap is used and the extent fields
+ * stay empty. store is open in an arena made by openFml and mirrors
+ * every extent, along with nextFitCursor, into its file.
+ */
+typedef struct fmlArena {
+    LinkedList *freeList;
+    LinkedList *usedList;
+    SizeIndex freeSizes;
+    AddressHash usedStarts;
+    SlabPool pages;
+    int policy;
+    long nextFitCursor;
+    BuddyAllocator buddy;
+    BitmapAllocator bitmap;
+    ExtentStore store;
+#ifdef FML_STATS
+    fmlStats stats;
+#endif
+} fmlArena;
+
+/*
+ * Returns the FML_POLICY_ constant named by name ("bestfit",
+ * "firstfit", "nextfit", "worstfit", "buddy" or "bitmap"), or -1.
+ */
+int lookupPolicy(const char *name);
+
+/*
+ * (Re)initialises arena to manage blockCount blocks, all free, placing
+ * allocations according to policy. A zero-filled fmlArena may be passed
+ * the first time. A persistent arena reinitialises its file and cannot
+ * switch to buddy or bitmap: that gives FML_ERR_UNSUPPORTED_POLICY,
+ * leaving the arena and its file as they were, as does a blockCount
+ * below 0 or above FML_MAX_BLOCKS, which gives FML_ERR_BAD_SIZE. If the
+ * new arena's structures cannot be allocated the result is
+ * FML_ERR_ALLOCATION_FAILED and the arena is left empty. Returns
+ * FML_SUCCESS otherwise.
+ */
+int initializeFml(fmlArena *arena,long blockCount,int policy);
+
+/*
+ * Opens a persistent arena whose extents live in the file at path. A
+ * new or empty file is initialised as by initializeFml; an existing one
+ * is checked with fs_check and the arena resumes from it, keeping the
+ * file's block count and policy and ignoring blockCount and policy.
+ * Resuming costs one pass over the extents and no replay. Only the
+ * extent policies can persist: FML_POLICY_BUDDY or FML_POLICY_BITMAP
+ * gives FS_ERR_UNSUPPORTED_POLICY, and a blockCount initializeFml would
+ * refuse gives FS_ERR_BAD_SIZE. Returns FS_SUCCESS or the FS_ERR_
+ * code that stopped the open, leaving arena empty.
+ */
+int openFml(fmlArena *arena, const char *path, long blockCount, int policy);
+
+/*
+ * Releases everything arena holds, closing a persistent arena's file
+ * with its state intact. The arena may be initialised again afterwards.
+ */
+void destroyFml(fmlArena *arena);
+
+/*
+ * Allocates requestedSize contiguous blocks from the free extent the
+ * arena's policy picks and stores the first block's address in
+ * acquiredAddress. Returns 1 on success and 0 if no free
+ * extent is large enough.
+ */
+int performAllocation(fmlArena *arena, long requestedSize, long *acquiredAddress);
+
+/*
+ * As performAllocation, but the first block's address is a multiple of
+ * alignment, which must be a power of two. Extent arenas pick among the
+ * free extents with room for the aligned block, as the policy would,
+ * and split the one chosen into the block and free extents for whatever
+ * lies before and after it; the bitmap takes the lowest aligned run and
+ * a buddy arena splits from a block at least alignment long. Nothing is
+ * lost to alignment either way. Timed as an allocation under FML_STATS.
+ * Returns 0 if requestedSize is not positive, alignment is not a power
+ * of two, or no free extent has room.
+ */
+int performAlignedAllocation(fmlArena *arena, long requestedSize, long alignment, long *acquiredAddress);
+
+/*
+ * Frees the allocation starting at blockBaseAddress. Returns 1 on
+ * success and 0 if blockBaseAddress is not the start of a used block.
+ */
+int performFree(fmlArena *arena, long blockBaseAddress);
+
+/*
+ * Changes the allocation starting at blockBaseAddress to newSize blocks
+ * and stores where it now starts in newAddress. Extent arenas shrink in
+ * place, handing the tail to the free extent after the block or to a
+ * new one, and grow in place by taking blocks from the free extent
+ * physically after it when that has enough. The bitmap does the same
+ * with the blocks after the allocation; a buddy allocation stays put
+ * while its block is still the right size. Otherwise the allocation
+ * moves: a new one is made while the old is still held, so the two
+ * never overlap, and only then is the old one freed. Returns 1 on
+ * success and 0, leaving the allocation as it was, if blockBaseAddress
+ * is not the start of a used block, newSize is not positive, or no room
+ * is found.
+ */
+int performResize(fmlArena *arena, long blockBaseAddress, long newSize, long *newAddress);
+
+/*
+ * Frees count allocations at once, setting results[i] to what
+ * performFree would have returned for blockBaseAddresses[i] had the
+ * addresses been freed one after another, and returns how many were
+ * freed. The extent backends coalesce the whole batch together and
+ * merge the resulting free extents into freeList in a single pass,
+ * O(n + k log k) for k addresses against n free extents. With
+ * FML_STATS the batch is timed as one free, which counts as failed
+ * unless every address was freed.
+ */
+long performFreeBatch(fmlArena *arena, long blockBaseAddresses[], long count, int results[]);
+
+/*
+ * Returns how many blocks the allocation starting at blockBaseAddress
+ * occupies, which under FML_POLICY_BUDDY is the whole power-of-two
+ * block, or 0 if no allocation starts there.
+ */
+long allocationBlocks(fmlArena *arena, long blockBaseAddress);
+
+/*
+ * Stores the first and last block of the free run holding address and
+ * returns 1, or returns 0 if address is not free. Extent arenas report
+ * the whole coalesced extent and the bitmap the maximal free run; a
+ * buddy arena reports the free buddy block, which may border free
+ * blocks it cannot merge with.
+ */
+int findFreeRun(fmlArena *arena, long address, long *runStart, long *runEnd);
+
+/*
+ * Calls mapFunc with the first and last block of every free (isFree
+ * non-zero) or used block, in address order, whatever the backend.
+ */
+void mapFmlBlocks(fmlArena *arena, int isFree, void *mapParam, void (mapFunc)(long, long, void *));
+
+/*
+ * Writes the FML_STATS latency histograms for arena and the LL_STATS
+ * list counters to out, with the arena's current free and used block
+ * counts so list length can be read against latency. Says so if the
+ * build has neither.
+ */
+void printFmlStats(fmlArena *arena, FILE *out);
+
+/*
+ * A monotonic clock in nanoseconds.
+ */
+long fmlNanos();
+
+/*
+ * Reports how many separate free blocks arena has and the size of the
+ * largest.
+ */
+void summarizeFreeBlocks(fmlArena *arena, long *freeBlockCount, long *largestFreeBlock);
+
+#endif
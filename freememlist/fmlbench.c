@@ -0,0 +1,601 @@
+//
+//  fmlbench.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/10/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fml.h"
+#ifdef LL_THREAD_SAFE
+#include <pthread.h>
+#include "fmlshard.h"
+#endif
+
+/*
+ * Replays a synthetic allocate/free workload against one fmlArena and
+ * reports throughput, latency percentiles, peak free-list length and
+ * fragmentation. Each allocation draws a size from the chosen
+ * distribution and an exponentially distributed lifetime (in
+ * operations); at every step the oldest expired allocation is freed if
+ * there is one, otherwise a new allocation is made, so about
+ * meanLifetime/2 allocations are live in the steady state.
+ *
+ * Fragmentation is 1 - largest free block / total free blocks. Internal
+ * fragmentation, the share of reserved blocks nobody asked for, is only
+ * non-zero under the buddy backend.
+ *
+ * Results go to stdout or -o as JSON, or as CSV with -f csv, where a
+ * header row is only written to an empty file so runs from different
+ * commits can be appended to one file and compared. -t attaches a label
+ * (a commit id, say) to the row.
+ *
+ * Built with LL_THREAD_SAFE (the fmlshardbench target), -j threads
+ * instead runs the workload on 1, 2, ... threads against an
+ * fmlShardedArena with one shard per thread. Every thread makes its own
+ * operations, so perfect scaling keeps wallSeconds flat; each row
+ * reports throughput and the speedup over one thread. The rows have
+ * their own CSV header, so keep them in a file of their own.
+ */
+
+#define BENCH_DIST_UNIFORM 0
+#define BENCH_DIST_GEOMETRIC 1
+#define BENCH_DIST_BIMODAL 2
+#define BENCH_DIST_FIXED 3
+
+typedef struct benchConfig {
+    long operations;
+    long arenaBlocks;
+    long maxSize;
+    double meanLifetime;
+    int distribution;
+    int policy;
+    unsigned long seed;
+    int csv;
+    const char *outputPath;
+    const char *label;
+    int threads;
+} benchConfig;
+
+typedef struct benchLive {
+    long death;
+    long address;
+    long size;
+} benchLive;
+
+typedef struct benchResults {
+    long allocations;
+    long frees;
+    long failedAllocations;
+    long *allocateNanos;
+    long *freeNanos;
+    double timedSeconds;
+    double wallSeconds;
+    long peakFreeListLength;
+    long peakLive;
+    double peakFragmentation;
+    double finalFragmentation;
+    double peakInternalFragmentation;
+} benchResults;
+
+static const char *distributionNames[] = {"uniform", "geometric", "bimodal", "fixed"};
+
+static unsigned long benchRandom(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static double benchUniform(unsigned long *state) {
+    return ((benchRandom(state) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static long benchSize(benchConfig *config, unsigned long *state) {
+    long size;
+    double mean;
+    switch(config->distribution) {
+        case BENCH_DIST_GEOMETRIC:
+            mean = config->maxSize/8.0 > 1.0 ? config->maxSize/8.0 : 1.0;
+            size = 1 + (long) floor(log(benchUniform(state)) / log(1.0-1.0/mean));
+            break;
+        case BENCH_DIST_BIMODAL:
+            if(benchRandom(state)%10==0) {
+                size = config->maxSize/2 + (long) (benchRandom(state) % (unsigned long) (config->maxSize-config->maxSize/2));
+            } else {
+                size = 1 + (long) (benchRandom(state)%8);
+            }
+            break;
+        case BENCH_DIST_FIXED:
+            size = config->maxSize;
+            break;
+        case BENCH_DIST_UNIFORM:
+        default:
+            size = 1 + (long) (benchRandom(state) % (unsigned long) config->maxSize);
+    }
+    if(size>config->maxSize) {
+        size = config->maxSize;
+    }
+    return size < 1 ? 1 : size;
+}
+
+/*
+ * Min-heap of live allocations ordered by death time.
+ */
+static void benchHeapPush(benchLive *heap, long *count, benchLive live) {
+    long i = (*count)++;
+    while(i>0 && heap[(i-1)/2].death > live.death) {
+        heap[i] = heap[(i-1)/2];
+        i = (i-1)/2;
+    }
+    heap[i] = live;
+}
+
+static benchLive benchHeapPop(benchLive *heap, long *count) {
+    benchLive top = heap[0];
+    benchLive last = heap[--(*count)];
+    long i = 0;
+    long child;
+    while((child = 2*i+1) < *count) {
+        if(child+1 < *count && heap[child+1].death < heap[child].death) {
+            child++;
+        }
+        if(heap[child].death >= last.death) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+/*
+ * 1 - largest/total over the free blocks: 0 when all free space is one
+ * extent, approaching 1 as it is scattered.
+ */
+static double benchFragmentation(long largestFreeBlock, long freeBlocks) {
+    double retval = 0.0;
+    if(freeBlocks>0) {
+        retval = 1.0 - (double) largestFreeBlock / (double) freeBlocks;
+    }
+    return retval;
+}
+
+/*
+ * Blocks actually taken out of the arena: what was asked for, except
+ * under the buddy backend, which rounds every request up.
+ */
+static long benchReservedBlocks(fmlArena *arena, long liveBlocks) {
+    return arena->policy==FML_POLICY_BUDDY ? arena->buddy.reservedBlocks : liveBlocks;
+}
+
+static int benchCompareLong(const void *a, const void *b) {
+    long left = *(const long *) a;
+    long right = *(const long *) b;
+    return (left>right) - (left<right);
+}
+
+static long benchPercentile(long *sorted, long count, double percentile) {
+    long index;
+    if(count==0) {
+        return 0;
+    }
+    index = (long) ceil(percentile/100.0*count) - 1;
+    return sorted[index<0 ? 0 : index];
+}
+
+/*
+ * Returns 0, having timed nothing, if the arena cannot be initialised
+ * with config's size and policy.
+ */
+static int benchRun(benchConfig *config, benchResults *results) {
+    int retval = 0;
+    fmlArena arena = {0};
+    benchLive *heap = malloc(sizeof(benchLive)*config->operations);
+    long liveCount = 0;
+    long liveBlocks = 0;
+    unsigned long state = config->seed ? config->seed : 1;
+    long step;
+    long size;
+    long address;
+    long started;
+    long elapsed;
+    long timedNanos = 0;
+    long wallStarted;
+    double fragmentation;
+    long freeBlockCount;
+    long largestFreeBlock;
+    long reservedBlocks;
+    benchLive live;
+    int allocated;
+    
+    memset(results, 0, sizeof(*results));
+    results->allocateNanos = malloc(sizeof(long)*config->operations);
+    results->freeNanos = malloc(sizeof(long)*config->operations);
+    
+    if(initializeFml(&arena, config->arenaBlocks, config->policy)==FML_SUCCESS) {
+        retval = 1;
+        wallStarted = fmlNanos();
+        
+        for(step=0;step<config->operations;step++) {
+            if(liveCount>0 && heap[0].death<=step) {
+                live = benchHeapPop(heap, &liveCount);
+                started = fmlNanos();
+                performFree(&arena, live.address);
+                elapsed = fmlNanos()-started;
+                results->freeNanos[results->frees++] = elapsed;
+                liveBlocks -= live.size;
+            } else {
+                size = benchSize(config, &state);
+                started = fmlNanos();
+                allocated = performAllocation(&arena, size, &address);
+                elapsed = fmlNanos()-started;
+                results->allocateNanos[results->allocations++] = elapsed;
+                if(allocated) {
+                    live.address = address;
+                    live.size = size;
+                    live.death = step + 1 + (long) (-log(benchUniform(&state)) * config->meanLifetime);
+                    benchHeapPush(heap, &liveCount, live);
+                    liveBlocks += size;
+                } else {
+                    results->failedAllocations++;
+                }
+            }
+            timedNanos += elapsed;
+            
+            summarizeFreeBlocks(&arena, &freeBlockCount, &largestFreeBlock);
+            reservedBlocks = benchReservedBlocks(&arena, liveBlocks);
+            if(freeBlockCount > results->peakFreeListLength) {
+                results->peakFreeListLength = freeBlockCount;
+            }
+            if(liveCount > results->peakLive) {
+                results->peakLive = liveCount;
+            }
+            if(reservedBlocks>0 && 1.0-(double) liveBlocks/reservedBlocks > results->peakInternalFragmentation) {
+                results->peakInternalFragmentation = 1.0-(double) liveBlocks/reservedBlocks;
+            }
+            fragmentation = benchFragmentation(largestFreeBlock, config->arenaBlocks-reservedBlocks);
+            if(fragmentation > results->peakFragmentation) {
+                results->peakFragmentation = fragmentation;
+            }
+        }
+        
+        results->wallSeconds = (fmlNanos()-wallStarted) / 1e9;
+        results->timedSeconds = timedNanos / 1e9;
+        
+        summarizeFreeBlocks(&arena, &freeBlockCount, &largestFreeBlock);
+        results->finalFragmentation = benchFragmentation(largestFreeBlock, config->arenaBlocks-benchReservedBlocks(&arena, liveBlocks));
+        
+        destroyFml(&arena);
+    }
+    free(heap);
+    return retval;
+}
+
+#ifdef LL_THREAD_SAFE
+
+/*
+ * One worker of a scaling run. started is the gate all workers spin on
+ * so they begin together; finished is when this one's timed loop ended.
+ */
+typedef struct benchWorker {
+    pthread_t thread;
+    benchConfig *config;
+    fmlShardedArena *shardedArena;
+    volatile int *started;
+    unsigned long seed;
+    long allocations;
+    long frees;
+    long failedAllocations;
+    long finished;
+} benchWorker;
+
+/*
+ * benchRun's workload through fmls_allocate/fmls_free, without the
+ * per-operation timing and fragmentation sampling, which would
+ * serialise on the clock and the shard locks. Allocations still live at
+ * the end are freed after finished is taken.
+ */
+static void *benchWorkerRun(void *argument) {
+    benchWorker *worker = argument;
+    benchConfig *config = worker->config;
+    benchLive *heap = malloc(sizeof(benchLive)*config->operations);
+    long liveCount = 0;
+    unsigned long state = worker->seed;
+    long step;
+    long address;
+    benchLive live;
+    
+    while(!__atomic_load_n(worker->started, __ATOMIC_ACQUIRE)) {
+        //Empty loop
+    }
+    
+    for(step=0;step<config->operations;step++) {
+        if(liveCount>0 && heap[0].death<=step) {
+            live = benchHeapPop(heap, &liveCount);
+            fmls_free(worker->shardedArena, live.address);
+            worker->frees++;
+        } else {
+            live.size = benchSize(config, &state);
+            worker->allocations++;
+            if(fmls_allocate(worker->shardedArena, live.size, &address)==FMLS_SUCCESS) {
+                live.address = address;
+                live.death = step + 1 + (long) (-log(benchUniform(&state)) * config->meanLifetime);
+                benchHeapPush(heap, &liveCount, live);
+            } else {
+                worker->failedAllocations++;
+            }
+        }
+    }
+    worker->finished = fmlNanos();
+    
+    while(liveCount>0) {
+        fmls_free(worker->shardedArena, benchHeapPop(heap, &liveCount).address);
+    }
+    free(heap);
+    return NULL;
+}
+
+/*
+ * Runs the workload on 1..config->threads threads and writes one row
+ * per thread count. Returns 0 if a sharded arena or thread could not be
+ * set up.
+ */
+static int benchScale(benchConfig *config, FILE *out, int writeHeader) {
+    int retval = 1;
+    fmlShardedArena shardedArena = {0};
+    benchWorker *workers = calloc((size_t) config->threads, sizeof(benchWorker));
+    volatile int started;
+    long wallStarted;
+    long wallNanos;
+    long allocations;
+    long frees;
+    long failedAllocations;
+    double opsPerSecond;
+    double baseline = 0.0;
+    int threads;
+    int created;
+    int i;
+    
+    if(config->csv && writeHeader) {
+        fprintf(out, "label,policy,distribution,threads,operations,arenaBlocks,maxSize,meanLifetime,seed,"
+                "allocations,frees,failedAllocations,opsPerSecond,wallSeconds,speedup\n");
+    } else if(!config->csv) {
+        fprintf(out, "{\n");
+        fprintf(out, "  \"label\": \"%s\",\n", config->label);
+        fprintf(out, "  \"config\": {\"policy\": \"%s\", \"distribution\": \"%s\", \"operations\": %li, \"arenaBlocks\": %li, "
+                "\"maxSize\": %li, \"meanLifetime\": %g, \"seed\": %lu, \"threads\": %i},\n",
+                fmlPolicyNames[config->policy], distributionNames[config->distribution], config->operations, config->arenaBlocks,
+                config->maxSize, config->meanLifetime, config->seed, config->threads);
+        fprintf(out, "  \"scaling\": [");
+    }
+    
+    for(threads=1;threads<=config->threads && retval;threads++) {
+        if(workers==NULL || fmls_initialize(&shardedArena, config->arenaBlocks, threads, config->policy)!=FMLS_SUCCESS) {
+            retval = 0;
+            break;
+        }
+        
+        started = 0;
+        for(created=0;created<threads;created++) {
+            memset(&workers[created], 0, sizeof(benchWorker));
+            workers[created].config = config;
+            workers[created].shardedArena = &shardedArena;
+            workers[created].started = &started;
+            workers[created].seed = (config->seed ? config->seed : 1) + 0x9e3779b97f4a7c15UL*(unsigned long) created;
+            if(workers[created].seed==0) {
+                workers[created].seed = 1;
+            }
+            if(pthread_create(&workers[created].thread, NULL, benchWorkerRun, &workers[created])!=0) {
+                retval = 0;
+                break;
+            }
+        }
+        
+        wallStarted = fmlNanos();
+        __atomic_store_n(&started, 1, __ATOMIC_RELEASE);
+        wallNanos = 0;
+        allocations = 0;
+        frees = 0;
+        failedAllocations = 0;
+        for(i=0;i<created;i++) {
+            pthread_join(workers[i].thread, NULL);
+            if(workers[i].finished-wallStarted > wallNanos) {
+                wallNanos = workers[i].finished-wallStarted;
+            }
+            allocations += workers[i].allocations;
+            frees += workers[i].frees;
+            failedAllocations += workers[i].failedAllocations;
+        }
+        
+        if(retval) {
+            opsPerSecond = wallNanos>0 ? (allocations+frees) / (wallNanos/1e9) : 0.0;
+            if(threads==1) {
+                baseline = opsPerSecond;
+            }
+            if(config->csv) {
+                fprintf(out, "%s,%s,%s,%i,%li,%li,%li,%g,%lu,%li,%li,%li,%.0f,%.6f,%.3f\n",
+                        config->label, fmlPolicyNames[config->policy], distributionNames[config->distribution],
+                        threads, config->operations, config->arenaBlocks, config->maxSize, config->meanLifetime, config->seed,
+                        allocations, frees, failedAllocations, opsPerSecond, wallNanos/1e9,
+                        baseline>0 ? opsPerSecond/baseline : 0.0);
+            } else {
+                fprintf(out, "%s\n    {\"threads\": %i, \"allocations\": %li, \"frees\": %li, \"failedAllocations\": %li, "
+                        "\"opsPerSecond\": %.0f, \"wallSeconds\": %.6f, \"speedup\": %.3f}",
+                        threads==1 ? "" : ",", threads, allocations, frees, failedAllocations,
+                        opsPerSecond, wallNanos/1e9, baseline>0 ? opsPerSecond/baseline : 0.0);
+            }
+        }
+    }
+    
+    if(!config->csv) {
+        fprintf(out, "\n  ]\n}\n");
+    }
+    fmls_destroy(&shardedArena);
+    free(workers);
+    return retval;
+}
+
+#endif
+
+static void benchReport(benchConfig *config, benchResults *results, FILE *out, int writeHeader) {
+    long ops = results->allocations+results->frees;
+    double opsPerSecond = results->timedSeconds>0 ? ops/results->timedSeconds : 0.0;
+    long *a = results->allocateNanos;
+    long *f = results->freeNanos;
+    long na = results->allocations;
+    long nf = results->frees;
+    
+    qsort(a, na, sizeof(long), benchCompareLong);
+    qsort(f, nf, sizeof(long), benchCompareLong);
+    
+    if(config->csv) {
+        if(writeHeader) {
+            fprintf(out, "label,policy,distribution,operations,arenaBlocks,maxSize,meanLifetime,seed,"
+                    "allocations,frees,failedAllocations,opsPerSecond,wallSeconds,"
+                    "allocateP50Ns,allocateP90Ns,allocateP99Ns,allocateP999Ns,allocateMaxNs,"
+                    "freeP50Ns,freeP90Ns,freeP99Ns,freeP999Ns,freeMaxNs,"
+                    "peakFreeListLength,peakLive,peakFragmentation,finalFragmentation,peakInternalFragmentation\n");
+        }
+        fprintf(out, "%s,%s,%s,%li,%li,%li,%g,%lu,%li,%li,%li,%.0f,%.6f,"
+                "%li,%li,%li,%li,%li,%li,%li,%li,%li,%li,%li,%li,%.6f,%.6f,%.6f\n",
+                config->label, fmlPolicyNames[config->policy], distributionNames[config->distribution],
+                config->operations, config->arenaBlocks, config->maxSize, config->meanLifetime, config->seed,
+                na, nf, results->failedAllocations, opsPerSecond, results->wallSeconds,
+                benchPercentile(a, na, 50), benchPercentile(a, na, 90), benchPercentile(a, na, 99),
+                benchPercentile(a, na, 99.9), benchPercentile(a, na, 100),
+                benchPercentile(f, nf, 50), benchPercentile(f, nf, 90), benchPercentile(f, nf, 99),
+                benchPercentile(f, nf, 99.9), benchPercentile(f, nf, 100),
+                results->peakFreeListLength, results->peakLive,
+                results->peakFragmentation, results->finalFragmentation, results->peakInternalFragmentation);
+    } else {
+        fprintf(out, "{\n");
+        fprintf(out, "  \"label\": \"%s\",\n", config->label);
+        fprintf(out, "  \"config\": {\"policy\": \"%s\", \"distribution\": \"%s\", \"operations\": %li, \"arenaBlocks\": %li, "
+                "\"maxSize\": %li, \"meanLifetime\": %g, \"seed\": %lu},\n",
+                fmlPolicyNames[config->policy], distributionNames[config->distribution], config->operations, config->arenaBlocks,
+                config->maxSize, config->meanLifetime, config->seed);
+        fprintf(out, "  \"allocations\": %li,\n  \"frees\": %li,\n  \"failedAllocations\": %li,\n",
+                na, nf, results->failedAllocations);
+        fprintf(out, "  \"opsPerSecond\": %.0f,\n  \"wallSeconds\": %.6f,\n", opsPerSecond, results->wallSeconds);
+        fprintf(out, "  \"allocateNs\": {\"p50\": %li, \"p90\": %li, \"p99\": %li, \"p999\": %li, \"max\": %li},\n",
+                benchPercentile(a, na, 50), benchPercentile(a, na, 90), benchPercentile(a, na, 99),
+                benchPercentile(a, na, 99.9), benchPercentile(a, na, 100));
+        fprintf(out, "  \"freeNs\": {\"p50\": %li, \"p90\": %li, \"p99\": %li, \"p999\": %li, \"max\": %li},\n",
+                benchPercentile(f, nf, 50), benchPercentile(f, nf, 90), benchPercentile(f, nf, 99),
+                benchPercentile(f, nf, 99.9), benchPercentile(f, nf, 100));
+        fprintf(out, "  \"peakFreeListLength\": %li,\n  \"peakLive\": %li,\n", results->peakFreeListLength, results->peakLive);
+        fprintf(out, "  \"peakFragmentation\": %.6f,\n  \"finalFragmentation\": %.6f,\n", results->peakFragmentation, results->finalFragmentation);
+        fprintf(out, "  \"peakInternalFragmentation\": %.6f\n", results->peakInternalFragmentation);
+        fprintf(out, "}\n");
+    }
+}
+
+static void benchUsage(const char *name) {
+    fprintf(stderr, "usage: %s [-n operations] [-a arenaBlocks] [-s maxSize] [-l meanLifetime]\n"
+            "       [-d uniform|geometric|bimodal|fixed] [-p bestfit|firstfit|nextfit|worstfit|buddy|bitmap]\n"
+            "       [-r seed] [-f json|csv] [-o file] [-t label]"
+#ifdef LL_THREAD_SAFE
+            " [-j threads]"
+#endif
+            "\n", name);
+}
+
+int main(int argc, const char * argv[])
+{
+    benchConfig config = {1000000, 1L<<20, 64, 1000.0, BENCH_DIST_UNIFORM, FML_POLICY_BESTFIT, 1, 0, NULL, "", 0};
+    benchResults results;
+    FILE *out = stdout;
+    int writeHeader = 1;
+    int status = 0;
+    int i;
+    int d;
+    
+    for(i=1;i<argc;i++) {
+        if(i+1>=argc || argv[i][0]!='-' || strlen(argv[i])!=2) {
+            benchUsage(argv[0]);
+            return 1;
+        }
+        switch(argv[i][1]) {
+            case 'n': config.operations = atol(argv[++i]); break;
+            case 'a': config.arenaBlocks = atol(argv[++i]); break;
+            case 's': config.maxSize = atol(argv[++i]); break;
+            case 'l': config.meanLifetime = atof(argv[++i]); break;
+            case 'r': config.seed = strtoul(argv[++i], NULL, 0); break;
+            case 'o': config.outputPath = argv[++i]; break;
+            case 't': config.label = argv[++i]; break;
+            case 'f': config.csv = strcmp(argv[++i], "csv")==0; break;
+#ifdef LL_THREAD_SAFE
+            case 'j': config.threads = atoi(argv[++i]); break;
+#endif
+            case 'p':
+                config.policy = lookupPolicy(argv[++i]);
+                if(config.policy<0) {
+                    benchUsage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'd':
+                i++;
+                for(d=BENCH_DIST_FIXED;d>=0 && strcmp(argv[i], distributionNames[d])!=0;d--) {
+                    //Empty loop
+                }
+                if(d<0) {
+                    benchUsage(argv[0]);
+                    return 1;
+                }
+                config.distribution = d;
+                break;
+            default:
+                benchUsage(argv[0]);
+                return 1;
+        }
+    }
+    
+    if(config.operations<1 || config.arenaBlocks<1 || config.maxSize<1 || config.meanLifetime<=0 || config.threads<0) {
+        benchUsage(argv[0]);
+        return 1;
+    }
+    
+    if(config.outputPath!=NULL) {
+        out = fopen(config.outputPath, config.csv ? "a" : "w");
+        if(out==NULL) {
+            perror(config.outputPath);
+            return 1;
+        }
+        writeHeader = ftell(out)==0;
+    }
+    
+#ifdef LL_THREAD_SAFE
+    if(config.threads>0) {
+        if(!benchScale(&config, out, writeHeader)) {
+            fprintf(stderr, "%s: cannot run %i threads\n", argv[0], config.threads);
+            status = 1;
+        }
+    } else
+#endif
+    {
+        if(benchRun(&config, &results)) {
+            benchReport(&config, &results, out, writeHeader);
+        } else {
+            fprintf(stderr, "%s: cannot initialise a %s arena of %li blocks\n",
+                    argv[0], fmlPolicyNames[config.policy], config.arenaBlocks);
+            status = 1;
+        }
+        free(results.allocateNanos);
+        free(results.freeNanos);
+    }
+    
+    if(out!=stdout) {
+        fclose(out);
+    }
+    
+    return status;
+}
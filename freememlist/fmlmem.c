@@ -0,0 +1,178 @@
+//
+//  fmlmem.c
+//  freememlist
+//
+//  Created by Kevin Carter on 8/8/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "fmlmem.h"
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+int fmlm_initialize(fmlMemoryArena *memoryArena, long blockCount, int policy, long releaseThreshold) {
+    int retval = FMLM_SUCCESS;
+    size_t blockBytes = (size_t) sysconf(_SC_PAGESIZE);
+    void *mapping;
+    int status;
+
+    if(memoryArena==NULL) {
+        retval = FMLM_NULL_ARENA;
+    } else if(policy<0 || policy>=FML_POLICY_COUNT) {
+        retval = FMLM_ERR_BAD_POLICY;
+    } else if(blockCount<1 || (size_t) blockCount > ((size_t) -1)/blockBytes) {
+        retval = FMLM_ERR_BAD_SIZE;
+    } else {
+        fmlm_destroy(memoryArena);
+        mapping = mmap(NULL, blockCount*blockBytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if(mapping==MAP_FAILED) {
+            retval = FMLM_ERR_MAP_FAILED;
+        } else {
+            memoryArena->base = mapping;
+            memoryArena->blockBytes = blockBytes;
+            memoryArena->blockCount = blockCount;
+            memoryArena->releaseThreshold = releaseThreshold;
+            memoryArena->releaseCalls = 0;
+            memoryArena->releasedBlocks = 0;
+            if((status=initializeFml(&memoryArena->arena, blockCount, policy))!=FML_SUCCESS) {
+                fmlm_destroy(memoryArena);
+                retval = (status==FML_ERR_BAD_SIZE ? FMLM_ERR_BAD_SIZE : FMLM_ERR_ARENA_FAILED);
+            }
+        }
+    }
+    return retval;
+}
+
+int fmlm_destroy(fmlMemoryArena *memoryArena) {
+    int retval = FMLM_SUCCESS;
+    if(memoryArena==NULL) {
+        retval = FMLM_NULL_ARENA;
+    } else {
+        if(memoryArena->base!=NULL) {
+            munmap(memoryArena->base, memoryArena->blockCount*memoryArena->blockBytes);
+            memoryArena->base = NULL;
+            memoryArena->blockCount = 0;
+        }
+        destroyFml(&memoryArena->arena);
+    }
+    return retval;
+}
+
+void *fmlm_blockPointer(fmlMemoryArena *memoryArena, long block) {
+    return memoryArena->base + block*memoryArena->blockBytes;
+}
+
+long fmlm_blockOf(fmlMemoryArena *memoryArena, void *pointer) {
+    long retval = -1;
+    char *address = pointer;
+    if(memoryArena->base!=NULL && address>=memoryArena->base &&
+       address<memoryArena->base+memoryArena->blockCount*memoryArena->blockBytes) {
+        retval = (long) ((size_t) (address-memoryArena->base)/memoryArena->blockBytes);
+    }
+    return retval;
+}
+
+void *fmlm_allocate(fmlMemoryArena *memoryArena, size_t bytes) {
+    return fmlm_allocateAligned(memoryArena, bytes, 1);
+}
+
+void *fmlm_allocateAligned(fmlMemoryArena *memoryArena, size_t bytes, long alignment) {
+    void *retval = NULL;
+    long blocks;
+    long block;
+
+    if(memoryArena->base!=NULL) {
+        blocks = (long) ((bytes+memoryArena->blockBytes-1)/memoryArena->blockBytes);
+        if(blocks<=memoryArena->blockCount &&
+           performAlignedAllocation(&memoryArena->arena, blocks>0 ? blocks : 1, alignment, &block)) {
+            retval = fmlm_blockPointer(memoryArena, block);
+        }
+    }
+    return retval;
+}
+
+/*
+ * Every free run of releaseThreshold pages or more is kept wholly
+ * released: it either came from the fresh mapping, was released when it
+ * formed, or lost pages to an allocation without gaining any. So when
+ * freeing pages first..last makes such a run, only those pages and
+ * whichever of the neighbouring free parts were too short to have been
+ * released need advising. A buddy block is not built from whole earlier
+ * runs, so it is advised in full.
+ *
+ * Released pages read back as zeros when next touched, while pages of
+ * shorter runs keep whatever was last written to them, so allocations
+ * are never guaranteed to be zeroed.
+ */
+static void fmlm_releaseFreed(fmlMemoryArena *memoryArena, long first, long last) {
+    long threshold = memoryArena->releaseThreshold;
+    long runStart;
+    long runEnd;
+    
+    if(findFreeRun(&memoryArena->arena, first, &runStart, &runEnd) && runEnd-runStart+1 >= threshold) {
+        if(memoryArena->arena.policy!=FML_POLICY_BUDDY) {
+            runStart = (first-runStart >= threshold ? first : runStart);
+            runEnd = (runEnd-last >= threshold ? last : runEnd);
+        }
+        if(madvise(fmlm_blockPointer(memoryArena, runStart), (runEnd-runStart+1)*memoryArena->blockBytes, MADV_DONTNEED)==0) {
+            memoryArena->releaseCalls++;
+            memoryArena->releasedBlocks += runEnd-runStart+1;
+        }
+    }
+}
+
+int fmlm_free(fmlMemoryArena *memoryArena, void *pointer) {
+    int retval = FMLM_ERR_NOT_ALLOCATED;
+    long block = fmlm_blockOf(memoryArena, pointer);
+    long blocks = allocationBlocks(&memoryArena->arena, block);
+    
+    if(block>=0 && blocks>0 && pointer==fmlm_blockPointer(memoryArena, block) &&
+       performFree(&memoryArena->arena, block)) {
+        retval = FMLM_SUCCESS;
+        fmlm_releaseFreed(memoryArena, block, block+blocks-1);
+    }
+    return retval;
+}
+
+/*
+ * A moved allocation's old pages are only freed inside the arena, never
+ * touched, so they are copied from after performResize and released
+ * last.
+ */
+void *fmlm_reallocate(fmlMemoryArena *memoryArena, void *pointer, size_t bytes) {
+    void *retval = NULL;
+    long block = fmlm_blockOf(memoryArena, pointer);
+    long oldBlocks = 0;
+    long newBlocks = 1;
+    long newBlock;
+    
+    if(block>=0) {
+        oldBlocks = allocationBlocks(&memoryArena->arena, block);
+        newBlocks = (long) ((bytes+memoryArena->blockBytes-1)/memoryArena->blockBytes);
+    }
+    if(newBlocks==0) {
+        newBlocks = 1;
+    }
+    if(block>=0 && oldBlocks>0 && pointer==fmlm_blockPointer(memoryArena, block) &&
+       newBlocks<=memoryArena->blockCount &&
+       performResize(&memoryArena->arena, block, newBlocks, &newBlock)) {
+        retval = fmlm_blockPointer(memoryArena, newBlock);
+        if(newBlock!=block) {
+            memcpy(retval, pointer, (newBlocks<oldBlocks ? newBlocks : oldBlocks)*memoryArena->blockBytes);
+            fmlm_releaseFreed(memoryArena, block, block+oldBlocks-1);
+        } else if(allocationBlocks(&memoryArena->arena, block)<oldBlocks) {
+            fmlm_releaseFreed(memoryArena, block+newBlocks, block+oldBlocks-1);
+        }
+    }
+    return retval;
+}
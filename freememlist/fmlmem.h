@@ -0,0 +1,110 @@
+//
+//  fmlmem.h
+//  freememlist
+//
+//  Created by Kevin Carter on 8/8/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_fmlmem_h
+#define freememlist_fmlmem_h
+
+#include <stddef.h>
+#include "fml.h"
+
+#define FMLM_SUCCESS 0
+#define FMLM_ERR_NOT_ALLOCATED 1
+#define FMLM_ERR_MAP_FAILED 2
+#define FMLM_ERR_BAD_POLICY 3
+#define FMLM_ERR_BAD_SIZE 4
+#define FMLM_ERR_ARENA_FAILED 5
+#define FMLM_NULL_ARENA -1
+
+/*
+ * The default releaseThreshold: free runs shorter than this many pages
+ * stay resident.
+ */
+#define FMLM_DEFAULT_RELEASE_BLOCKS 16
+
+/*
+ * An fmlArena whose blocks are the pages of a real anonymous mapping.
+ * Block n is the page at base + n*blockBytes, blockBytes being the
+ * system page size, so allocations come back as usable pointers.
+ *
+ * Freeing returns pages to the system with madvise(MADV_DONTNEED) once
+ * the coalesced free run they end up in is at least releaseThreshold
+ * pages long. Shorter runs keep their pages, so the small, hot blocks
+ * that are freed and reused over and over never pay for a syscall and
+ * fresh zero pages; a threshold of 0 or 1 releases on every free. Pages
+ * already released are not advised again when their run grows, except
+ * under FML_POLICY_BUDDY (see fmlm_free), so releaseThreshold is set
+ * once at initialisation. releaseCalls and releasedBlocks count the
+ * madvise calls made and the pages they covered.
+ */
+typedef struct fmlMemoryArena {
+    fmlArena arena;
+    char *base;
+    size_t blockBytes;
+    long blockCount;
+    long releaseThreshold;
+    long releaseCalls;
+    long releasedBlocks;
+} fmlMemoryArena;
+
+/*
+ * (Re)initialises memoryArena over a fresh mapping of blockCount pages,
+ * placing allocations with policy. A zero-filled fmlMemoryArena may be
+ * passed the first time. The mapping reserves address space only;
+ * pages are backed as they are first touched. If the arena over it
+ * cannot be initialised the mapping is released again and
+ * FMLM_ERR_BAD_SIZE (too many pages for the backend) or
+ * FMLM_ERR_ARENA_FAILED is returned.
+ */
+int fmlm_initialize(fmlMemoryArena *memoryArena, long blockCount, int policy, long releaseThreshold);
+
+/*
+ * Unmaps the region and releases the arena. Every pointer handed out
+ * becomes invalid.
+ */
+int fmlm_destroy(fmlMemoryArena *memoryArena);
+
+/*
+ * Returns a page-aligned pointer to at least bytes bytes (one page for
+ * a request of 0), or NULL if no free run is large enough.
+ */
+void *fmlm_allocate(fmlMemoryArena *memoryArena, size_t bytes);
+
+/*
+ * As fmlm_allocate, but the allocation starts at a page whose number is
+ * a multiple of alignment, a power of two. Pages are numbered from base,
+ * which the system only aligns to a page, so the pointer itself is only
+ * as aligned as base allows.
+ */
+void *fmlm_allocateAligned(fmlMemoryArena *memoryArena, size_t bytes, long alignment);
+
+/*
+ * Frees the allocation at pointer, releasing its coalesced free run to
+ * the system if the run reaches releaseThreshold. Returns
+ * FMLM_ERR_NOT_ALLOCATED if pointer is not the start of an allocation.
+ */
+int fmlm_free(fmlMemoryArena *memoryArena, void *pointer);
+
+/*
+ * Resizes the allocation at pointer to hold at least bytes bytes and
+ * returns where it now starts, or NULL, leaving it untouched, if
+ * pointer is not the start of an allocation or there is no room. Grows
+ * and shrinks happen in place when performResize allows; a moved
+ * allocation has its contents copied, as far as the smaller of the two
+ * sizes, and its old pages released as by fmlm_free. The tail a shrink
+ * gives up is released the same way.
+ */
+void *fmlm_reallocate(fmlMemoryArena *memoryArena, void *pointer, size_t bytes);
+
+/*
+ * Converts between pointers into the region and block addresses.
+ * fmlm_blockOf returns -1 for a pointer outside the region.
+ */
+void *fmlm_blockPointer(fmlMemoryArena *memoryArena, long block);
+long fmlm_blockOf(fmlMemoryArena *memoryArena, void *pointer);
+
+#endif
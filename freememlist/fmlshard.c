@@ -0,0 +1,174 @@
+//
+//  fmlshard.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/7/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include "fmlshard.h"
+
+#ifdef LL_THREAD_SAFE
+
+/*
+ * Home shard slots are handed out round-robin across all threads and
+ * reduced modulo shardCount at use, so one slot serves every sharded
+ * arena a thread talks to.
+ */
+static int fmls_nextSlot = 0;
+static __thread int fmls_homeSlot = -1;
+
+static int fmls_homeShard(fmlShardedArena *shardedArena) {
+    if(fmls_homeSlot<0) {
+        fmls_homeSlot = __atomic_fetch_add(&fmls_nextSlot, 1, __ATOMIC_RELAXED) & 0x7fffffff;
+    }
+    return fmls_homeSlot % shardedArena->shardCount;
+}
+
+static int fmls_ownerShard(fmlShardedArena *shardedArena, long blockBaseAddress) {
+    long shard = blockBaseAddress / shardedArena->blocksPerShard;
+    if(shard >= shardedArena->shardCount) {
+        shard = shardedArena->shardCount-1;
+    }
+    return (int) shard;
+}
+
+static int fmls_allocateFrom(fmlShard *shard, long requestedSize, long *acquiredAddress) {
+    int retval = 0;
+    long localAddress;
+    if(requestedSize <= shard->blockCount && performAllocation(&shard->arena, requestedSize, &localAddress)) {
+        *acquiredAddress = shard->base + localAddress;
+        retval = 1;
+    }
+    return retval;
+}
+
+int fmls_initialize(fmlShardedArena *shardedArena, long blockCount, int shardCount, int policy) {
+    int retval = FMLS_SUCCESS;
+    int status = FML_SUCCESS;
+    int i;
+    fmlShard *shard;
+    
+    if(shardedArena==NULL) {
+        retval = FMLS_NULL_ARENA;
+    } else if(shardCount<1 || blockCount<shardCount) {
+        retval = FMLS_ERR_BAD_SHARD_COUNT;
+    } else if(policy<0 || policy>=FML_POLICY_COUNT) {
+        retval = FMLS_ERR_BAD_POLICY;
+    } else {
+        fmls_destroy(shardedArena);
+        if(posix_memalign((void **) &shardedArena->shards, FMLS_CACHE_LINE, sizeof(fmlShard)*shardCount)!=0) {
+            shardedArena->shards = NULL;
+            retval = FMLS_ERR_ALLOCATION_FAILED;
+        } else {
+            memset(shardedArena->shards, 0, sizeof(fmlShard)*shardCount);
+            shardedArena->shardCount = shardCount;
+            shardedArena->blockCount = blockCount;
+            shardedArena->blocksPerShard = blockCount / shardCount;
+            
+            for(i=0;i<shardCount && status==FML_SUCCESS;i++) {
+                shard = &shardedArena->shards[i];
+                pthread_mutex_init(&shard->lock, NULL);
+                shard->base = i * shardedArena->blocksPerShard;
+                shard->blockCount = (i==shardCount-1 ? blockCount-shard->base : shardedArena->blocksPerShard);
+                status = initializeFml(&shard->arena, shard->blockCount, policy);
+            }
+            
+            if(status!=FML_SUCCESS) {
+                /* only the first i shards have a lock to destroy */
+                shardedArena->shardCount = i;
+                fmls_destroy(shardedArena);
+                retval = (status==FML_ERR_BAD_SIZE ? FMLS_ERR_BAD_SIZE : FMLS_ERR_ALLOCATION_FAILED);
+            }
+        }
+    }
+    
+    return retval;
+}
+
+int fmls_destroy(fmlShardedArena *shardedArena) {
+    int retval = FMLS_SUCCESS;
+    int i;
+    
+    if(shardedArena==NULL) {
+        retval = FMLS_NULL_ARENA;
+    } else {
+        if(shardedArena->shards!=NULL) {
+            for(i=0;i<shardedArena->shardCount;i++) {
+                destroyFml(&shardedArena->shards[i].arena);
+                pthread_mutex_destroy(&shardedArena->shards[i].lock);
+            }
+            free(shardedArena->shards);
+        }
+        memset(shardedArena, 0, sizeof(*shardedArena));
+    }
+    
+    return retval;
+}
+
+/*
+ * Tries the home shard first. Stealing then makes one pass that only
+ * trylocks, so a busy shard is skipped rather than waited on, and only
+ * if that finds nothing a second pass that blocks on each lock in turn.
+ */
+int fmls_allocate(fmlShardedArena *shardedArena, long requestedSize, long *acquiredAddress) {
+    int retval = FMLS_ERR_NO_CONTIGUOUS;
+    int home;
+    int pass;
+    int i;
+    int found = 0;
+    fmlShard *shard;
+    
+    if(shardedArena==NULL || shardedArena->shards==NULL) {
+        retval = FMLS_NULL_ARENA;
+    } else {
+        home = fmls_homeShard(shardedArena);
+        shard = &shardedArena->shards[home];
+        pthread_mutex_lock(&shard->lock);
+        found = fmls_allocateFrom(shard, requestedSize, acquiredAddress);
+        pthread_mutex_unlock(&shard->lock);
+        
+        for(pass=0;pass<2 && !found;pass++) {
+            for(i=1;i<shardedArena->shardCount && !found;i++) {
+                shard = &shardedArena->shards[(home+i) % shardedArena->shardCount];
+                if(pass==0) {
+                    if(pthread_mutex_trylock(&shard->lock)!=0) {
+                        continue;
+                    }
+                } else {
+                    pthread_mutex_lock(&shard->lock);
+                }
+                found = fmls_allocateFrom(shard, requestedSize, acquiredAddress);
+                pthread_mutex_unlock(&shard->lock);
+            }
+        }
+        
+        if(found) {
+            retval = FMLS_SUCCESS;
+        }
+    }
+    
+    return retval;
+}
+
+int fmls_free(fmlShardedArena *shardedArena, long blockBaseAddress) {
+    int retval = FMLS_ERR_NOT_ALLOCATED;
+    fmlShard *shard;
+    
+    if(shardedArena==NULL || shardedArena->shards==NULL) {
+        retval = FMLS_NULL_ARENA;
+    } else if(blockBaseAddress>=0 && blockBaseAddress<shardedArena->blockCount) {
+        shard = &shardedArena->shards[fmls_ownerShard(shardedArena, blockBaseAddress)];
+        pthread_mutex_lock(&shard->lock);
+        if(performFree(&shard->arena, blockBaseAddress-shard->base)) {
+            retval = FMLS_SUCCESS;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    return retval;
+}
+
+#endif
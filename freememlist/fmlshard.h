@@ -0,0 +1,96 @@
+//
+//  fmlshard.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/7/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_fmlshard_h
+#define freememlist_fmlshard_h
+
+#include "fml.h"
+
+/*
+ * The sharded engine is only available in LL_THREAD_SAFE builds, where
+ * the list pools every arena draws from may be used from any thread.
+ */
+#ifdef LL_THREAD_SAFE
+
+#include <pthread.h>
+
+#define FMLS_CACHE_LINE 64
+
+#define FMLS_SUCCESS 0
+#define FMLS_ERR_NO_CONTIGUOUS 1
+#define FMLS_ERR_NOT_ALLOCATED 2
+#define FMLS_ERR_BAD_SHARD_COUNT 3
+#define FMLS_ERR_ALLOCATION_FAILED 4
+#define FMLS_ERR_BAD_POLICY 5
+#define FMLS_ERR_BAD_SIZE 6
+#define FMLS_NULL_ARENA -1
+
+/*
+ * One slice of the block space. arena manages blocks 0..blockCount-1
+ * locally; base turns those into global addresses. Each shard is
+ * padded out to its own cache lines so threads working on neighbouring
+ * shards do not false-share their locks.
+ */
+typedef struct fmlShard {
+    pthread_mutex_t lock;
+    fmlArena arena;
+    long base;
+    long blockCount;
+    char pad[FMLS_CACHE_LINE];
+} fmlShard;
+
+/*
+ * Splits blockCount blocks into shardCount equal arenas (the last one
+ * takes the remainder). A thread allocates from its home shard, picked
+ * round-robin the first time it calls in, and steals from the others
+ * only when its own cannot satisfy a request. Frees are routed by
+ * address to whichever shard owns the block, so any thread may free
+ * anything.
+ *
+ * An allocation never spans two shards, so the largest request that can
+ * succeed is the size of the largest shard.
+ */
+typedef struct fmlShardedArena {
+    fmlShard *shards;
+    int shardCount;
+    long blocksPerShard;
+    long blockCount;
+} fmlShardedArena;
+
+/*
+ * (Re)initialises shardedArena. A zero-filled fmlShardedArena may be
+ * passed the first time. shardCount must be at least 1 and no larger
+ * than blockCount. Every shard places allocations with policy, one of
+ * the FML_POLICY_ constants. If a shard cannot be initialised, the
+ * shards already built are released and FMLS_ERR_BAD_SIZE (a shard too
+ * large for its backend) or FMLS_ERR_ALLOCATION_FAILED is returned.
+ */
+int fmls_initialize(fmlShardedArena *shardedArena, long blockCount, int shardCount, int policy);
+
+/*
+ * Releases every shard. Must not race with any other call on
+ * shardedArena.
+ */
+int fmls_destroy(fmlShardedArena *shardedArena);
+
+/*
+ * Allocates requestedSize contiguous blocks and stores the global
+ * address of the first in acquiredAddress. Returns
+ * FMLS_ERR_NO_CONTIGUOUS if no shard has room.
+ */
+int fmls_allocate(fmlShardedArena *shardedArena, long requestedSize, long *acquiredAddress);
+
+/*
+ * Frees the allocation starting at the global address blockBaseAddress.
+ * Returns FMLS_ERR_NOT_ALLOCATED if it is not the start of a used block.
+ */
+int fmls_free(fmlShardedArena *shardedArena, long blockBaseAddress);
+
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+//
+//  fmlstore.c
+//  freememlist
+//
+//  Created by Kevin Carter on 8/6/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fmlstore.h"
+
+#define FS_INITIAL_CAPACITY 64
+
+static const char fs_magic[8] = {'F', 'M', 'L', 'S', 'T', 'O', 'R', 'E'};
+
+#define fs_bytesFor(capacity) (sizeof(ExtentStoreHeader) + (size_t) (capacity)*sizeof(ExtentRecord))
+
+static int fs_map(ExtentStore *store, size_t bytes) {
+    int retval = FS_SUCCESS;
+    void *mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if(mapping==MAP_FAILED) {
+        retval = FS_ERR_IO;
+    } else {
+        store->header = mapping;
+        store->records = (ExtentRecord *) (store->header+1);
+        store->mappedBytes = bytes;
+    }
+    return retval;
+}
+
+static void fs_unmap(ExtentStore *store) {
+    munmap(store->header, store->mappedBytes);
+    store->header = NULL;
+    store->records = NULL;
+    store->mappedBytes = 0;
+}
+
+/*
+ * Chains records from..to-1 onto the front of the spare chain.
+ */
+static void fs_spareRange(ExtentStore *store, long from, long to) {
+    long i;
+    for(i=to-1;i>=from;i--) {
+        store->records[i].isFree = FS_SPARE_RECORD;
+        store->records[i].previous = FS_NO_RECORD;
+        store->records[i].next = store->header->spare;
+        store->header->spare = i;
+    }
+}
+
+/*
+ * The file is extended and the larger mapping made before the old one
+ * is dropped, so a failed grow leaves the store as it was.
+ */
+static int fs_grow(ExtentStore *store) {
+    int retval = FS_SUCCESS;
+    ExtentStore grown = *store;
+    long capacity = store->header->capacity;
+    long newCapacity = capacity>0 ? capacity*2 : FS_INITIAL_CAPACITY;
+
+    if(ftruncate(store->fd, (off_t) fs_bytesFor(newCapacity))!=0 ||
+       fs_map(&grown, fs_bytesFor(newCapacity))!=FS_SUCCESS) {
+        retval = FS_ERR_ALLOCATION_FAILED;
+    } else {
+        fs_unmap(store);
+        *store = grown;
+        store->header->capacity = newCapacity;
+        fs_spareRange(store, capacity, newCapacity);
+    }
+    return retval;
+}
+
+int fs_open(ExtentStore *store, const char *path, int *created) {
+    int retval = FS_SUCCESS;
+    struct stat status;
+
+    if(store==NULL) {
+        return FS_NULL_STORE;
+    }
+
+    *created = 0;
+    store->header = NULL;
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(store->fd<0 || fstat(store->fd, &status)!=0) {
+        retval = FS_ERR_IO;
+    } else if(status.st_size==0) {
+        *created = 1;
+        if(ftruncate(store->fd, (off_t) fs_bytesFor(FS_INITIAL_CAPACITY))!=0 ||
+           (retval = fs_map(store, fs_bytesFor(FS_INITIAL_CAPACITY)))!=FS_SUCCESS) {
+            retval = FS_ERR_IO;
+        } else {
+            memcpy(store->header->magic, fs_magic, sizeof(fs_magic));
+            store->header->version = FS_VERSION;
+            store->header->capacity = FS_INITIAL_CAPACITY;
+            fs_reset(store, 0, 0);
+        }
+    } else if((size_t) status.st_size<sizeof(ExtentStoreHeader)) {
+        retval = FS_ERR_BAD_FORMAT;
+    } else if((retval = fs_map(store, (size_t) status.st_size))==FS_SUCCESS) {
+        if(memcmp(store->header->magic, fs_magic, sizeof(fs_magic))!=0 ||
+           store->header->version!=FS_VERSION ||
+           store->header->capacity<0 ||
+           fs_bytesFor(store->header->capacity)!=(size_t) status.st_size) {
+            retval = FS_ERR_BAD_FORMAT;
+        } else {
+            retval = fs_check(store);
+        }
+    }
+
+    if(retval!=FS_SUCCESS) {
+        if(store->header!=NULL) {
+            fs_unmap(store);
+        }
+        if(store->fd>=0) {
+            close(store->fd);
+        }
+        store->fd = -1;
+    }
+    return retval;
+}
+
+void fs_close(ExtentStore *store) {
+    if(store!=NULL && fs_isOpen(store)) {
+        msync(store->header, store->mappedBytes, MS_SYNC);
+        fs_unmap(store);
+        close(store->fd);
+        store->fd = -1;
+    }
+}
+
+void fs_reset(ExtentStore *store, long blockCount, int policy) {
+    store->header->policy = policy;
+    store->header->blockCount = blockCount;
+    store->header->nextFitCursor = 0;
+    store->header->recordCount = 0;
+    store->header->first = FS_NO_RECORD;
+    store->header->spare = FS_NO_RECORD;
+    fs_spareRange(store, 0, store->header->capacity);
+}
+
+int fs_check(ExtentStore *store) {
+    ExtentStoreHeader *header = store->header;
+    ExtentRecord *record;
+    long previous = FS_NO_RECORD;
+    long expectedStart = 0;
+    long count = 0;
+    long index;
+    int previousFree = 0;
+
+    if(header->recordCount<0 || header->recordCount>header->capacity || header->blockCount<0) {
+        return FS_ERR_INCONSISTENT;
+    }
+
+    for(index=header->first;index!=FS_NO_RECORD;previous=index,index=record->next) {
+        if(index<0 || index>=header->capacity || count++==header->recordCount) {
+            return FS_ERR_INCONSISTENT;
+        }
+        record = &store->records[index];
+        if(record->previous!=previous ||
+           record->start!=expectedStart ||
+           record->end<record->start-1 ||
+           (record->isFree!=0 && record->isFree!=1) ||
+           (record->isFree && previousFree)) {
+            return FS_ERR_INCONSISTENT;
+        }
+        expectedStart = record->end+1;
+        previousFree = (int) record->isFree;
+    }
+    if(count!=header->recordCount || expectedStart!=header->blockCount) {
+        return FS_ERR_INCONSISTENT;
+    }
+
+    for(index=header->spare;index!=FS_NO_RECORD;index=record->next) {
+        if(index<0 || index>=header->capacity || count++==header->capacity) {
+            return FS_ERR_INCONSISTENT;
+        }
+        record = &store->records[index];
+        if(record->isFree!=FS_SPARE_RECORD) {
+            return FS_ERR_INCONSISTENT;
+        }
+    }
+    return count==header->capacity ? FS_SUCCESS : FS_ERR_INCONSISTENT;
+}
+
+long fs_allocRecord(ExtentStore *store) {
+    long retval = FS_NO_RECORD;
+    if(store->header->spare!=FS_NO_RECORD || fs_grow(store)==FS_SUCCESS) {
+        retval = store->header->spare;
+        store->header->spare = store->records[retval].next;
+        store->records[retval].next = FS_NO_RECORD;
+        store->header->recordCount++;
+    }
+    return retval;
+}
+
+void fs_releaseRecord(ExtentStore *store, long record) {
+    store->records[record].isFree = FS_SPARE_RECORD;
+    store->records[record].previous = FS_NO_RECORD;
+    store->records[record].next = store->header->spare;
+    store->header->spare = record;
+    store->header->recordCount--;
+}
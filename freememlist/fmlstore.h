@@ -0,0 +1,120 @@
+//
+//  fmlstore.h
+//  freememlist
+//
+//  Created by Kevin Carter on 8/6/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_fmlstore_h
+#define freememlist_fmlstore_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FS_SUCCESS 0
+#define FS_ERR_IO 1
+#define FS_ERR_BAD_FORMAT 2
+#define FS_ERR_INCONSISTENT 3
+#define FS_ERR_ALLOCATION_FAILED 4
+#define FS_ERR_UNSUPPORTED_POLICY 5
+#define FS_ERR_BAD_SIZE 6
+#define FS_NULL_STORE -1
+
+/*
+ * The link value meaning "no record", and the isFree value of a record
+ * on the spare chain.
+ */
+#define FS_NO_RECORD -1
+#define FS_SPARE_RECORD -1
+
+#define FS_VERSION 1
+
+/*
+ * One extent of the arena as it is kept on disk: blocks start..end, free
+ * or used, and its physical neighbours. previous and next are indexes
+ * into the record array rather than pointers, so the file means the same
+ * thing wherever it is mapped. Spare records are chained through next.
+ */
+typedef struct ExtentRecord {
+    int64_t start;
+    int64_t end;
+    int64_t previous;
+    int64_t next;
+    int64_t isFree;
+} ExtentRecord;
+
+/*
+ * The start of the file, followed by capacity records. first is the
+ * record of the lowest-addressed extent and spare the head of the spare
+ * chain; recordCount counts the records in use.
+ */
+typedef struct ExtentStoreHeader {
+    char magic[8];
+    int64_t version;
+    int64_t policy;
+    int64_t blockCount;
+    int64_t nextFitCursor;
+    int64_t capacity;
+    int64_t recordCount;
+    int64_t first;
+    int64_t spare;
+} ExtentStoreHeader;
+
+/*
+ * A file holding an arena's boundary-tag chain, mapped shared so every
+ * change reaches the file without an explicit write. Only the chain is
+ * kept; the size index, address hash and lists are derived from it
+ * when the file is opened. header is NULL while no file is open.
+ */
+typedef struct ExtentStore {
+    ExtentStoreHeader *header;
+    ExtentRecord *records;
+    size_t mappedBytes;
+    int fd;
+} ExtentStore;
+
+#define fs_isOpen(store) ((store)->header!=NULL)
+#define fs_record(store, index) (&(store)->records[index])
+
+/*
+ * Maps the store in the file at path, creating an empty store (no
+ * records, blockCount 0) if the file does not exist or is empty, and
+ * sets *created accordingly. An existing file must pass fs_check.
+ */
+int fs_open(ExtentStore *store, const char *path, int *created);
+
+/*
+ * Unmaps the store after flushing it to disk. The file keeps its
+ * contents; store may be opened again afterwards.
+ */
+void fs_close(ExtentStore *store);
+
+/*
+ * Returns every record to the spare chain and records blockCount and
+ * policy, ready for the caller to add the first extent.
+ */
+void fs_reset(ExtentStore *store, long blockCount, int policy);
+
+/*
+ * Walks the chain in one pass, checking that the extents are in bounds,
+ * linked both ways, contiguous, never two free in a row, and cover
+ * blocks 0..blockCount-1 exactly, and that every other record is spare.
+ * A file left half-updated by a crash fails with FS_ERR_INCONSISTENT.
+ */
+int fs_check(ExtentStore *store);
+
+/*
+ * Takes a record off the spare chain, doubling the file when the chain
+ * is empty, and returns its index or FS_NO_RECORD if the file could not
+ * grow. Growing remaps the file, so pointers from fs_record must not be
+ * held across this call; indexes stay valid.
+ */
+long fs_allocRecord(ExtentStore *store);
+
+/*
+ * Returns record to the spare chain.
+ */
+void fs_releaseRecord(ExtentStore *store, long record);
+
+#endif
@@ -0,0 +1,581 @@
+//
+//  fmltrace.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/9/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fmltrace.h"
+#include "fml.h"
+
+#define FT_WRITER_BYTES 65536
+#define FT_READ_CHUNK 65536
+
+#define FT_OP_UNKNOWN 0
+#define FT_OP_END -1
+
+#define FT_POLICY_NAME_BYTES 16
+
+/*
+ * One command from either kind of trace. extras holds the arguments
+ * after the first, the addresses of a freebatch, and grows as needed.
+ * The same TraceCommand is reused for every command of a trace, so a
+ * missing argument keeps its previous value, as scanf leaves it in the
+ * interactive loop.
+ */
+typedef struct TraceCommand {
+    int op;
+    int policy;
+    long argument;
+    long *extras;
+    long extraCount;
+    long extraCapacity;
+} TraceCommand;
+
+typedef struct TraceWriter {
+    FILE *out;
+    size_t used;
+    int failed;
+    char buffer[FT_WRITER_BYTES];
+} TraceWriter;
+
+/*
+ * The whole input, either mapped (mapped!=0) or read into a malloc'd
+ * buffer when mapping is not possible (standard input, pipes).
+ */
+typedef struct TraceInput {
+    const char *data;
+    size_t length;
+    int mapped;
+} TraceInput;
+
+static void ft_flush(TraceWriter *writer) {
+    if(writer->used>0 && !writer->failed) {
+        if(fwrite(writer->buffer, 1, writer->used, writer->out)!=writer->used) {
+            writer->failed=1;
+        }
+    }
+    writer->used=0;
+}
+
+static void ft_write(TraceWriter *writer, const char *bytes, size_t length) {
+    size_t chunk;
+    while(length>0) {
+        if(writer->used==FT_WRITER_BYTES) {
+            ft_flush(writer);
+        }
+        chunk = FT_WRITER_BYTES-writer->used;
+        if(chunk>length) {
+            chunk=length;
+        }
+        memcpy(writer->buffer+writer->used, bytes, chunk);
+        writer->used+=chunk;
+        bytes+=chunk;
+        length-=chunk;
+    }
+}
+
+#define ft_writeLiteral(writer, literal) ft_write((writer), (literal), sizeof(literal)-1)
+
+static void ft_writeLong(TraceWriter *writer, long value) {
+    char digits[24];
+    int position = sizeof(digits);
+    unsigned long magnitude = value<0 ? 0UL-(unsigned long) value : (unsigned long) value;
+    
+    do {
+        digits[--position] = '0' + (char) (magnitude%10);
+        magnitude/=10;
+    } while(magnitude>0);
+    if(value<0) {
+        digits[--position] = '-';
+    }
+    ft_write(writer, digits+position, sizeof(digits)-position);
+}
+
+static int ft_openInput(const char *path, TraceInput *input) {
+    int retval = FT_SUCCESS;
+    int fd = 0;
+    struct stat info;
+    char *buffer = NULL;
+    char *grown;
+    size_t capacity = 0;
+    ssize_t got;
+    
+    memset(input, 0, sizeof(*input));
+    if(strcmp(path, "-")!=0) {
+        fd = open(path, O_RDONLY);
+    }
+    
+    if(fd<0) {
+        retval = FT_ERR_OPEN_FAILED;
+    } else {
+        if(fd!=0 && fstat(fd, &info)==0 && S_ISREG(info.st_mode) && info.st_size>0) {
+            input->data = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(input->data!=MAP_FAILED) {
+                input->length = (size_t) info.st_size;
+                input->mapped = 1;
+#ifdef MADV_SEQUENTIAL
+                madvise((void *) input->data, input->length, MADV_SEQUENTIAL);
+#endif
+            } else {
+                input->data = NULL;
+            }
+        }
+        
+        while(!input->mapped) {
+            if(capacity-input->length < FT_READ_CHUNK) {
+                capacity = capacity*2 + FT_READ_CHUNK;
+                grown = realloc(buffer, capacity);
+                if(grown==NULL) {
+                    retval = FT_ERR_OPEN_FAILED;
+                    break;
+                }
+                buffer = grown;
+            }
+            got = read(fd, buffer+input->length, capacity-input->length);
+            if(got<=0) {
+                if(got<0) {
+                    retval = FT_ERR_OPEN_FAILED;
+                }
+                break;
+            }
+            input->length+=(size_t) got;
+        }
+        if(!input->mapped) {
+            input->data = buffer;
+        }
+        
+        if(fd!=0) {
+            close(fd);
+        }
+    }
+    
+    return retval;
+}
+
+static void ft_closeInput(TraceInput *input) {
+    if(input->mapped) {
+        munmap((void *) input->data, input->length);
+    } else {
+        free((void *) input->data);
+    }
+    memset(input, 0, sizeof(*input));
+}
+
+static int ft_isSpace(char c) {
+    return c==' ' || c=='\n' || c=='\t' || c=='\r' || c=='\v' || c=='\f';
+}
+
+/*
+ * Appends value to command's extras. Returns 0, dropping it, if they
+ * cannot grow.
+ */
+static int ft_addExtra(TraceCommand *command, long value) {
+    int retval = 1;
+    long capacity;
+    long *grown;
+    
+    if(command->extraCount==command->extraCapacity) {
+        capacity = command->extraCapacity*2 + 16;
+        grown = realloc(command->extras, (size_t) capacity*sizeof(*grown));
+        if(grown==NULL) {
+            retval = 0;
+        } else {
+            command->extras = grown;
+            command->extraCapacity = capacity;
+        }
+    }
+    if(retval) {
+        command->extras[command->extraCount++] = value;
+    }
+    return retval;
+}
+
+/*
+ * Reads a decimal number after any whitespace at *cursor into *value
+ * and returns 1, or returns 0 leaving both alone if there is none.
+ */
+static int ft_readNumber(const char **cursor, const char *end, long *value) {
+    int retval = 0;
+    int negative = 0;
+    long magnitude = 0;
+    const char *p = *cursor;
+    
+    while(p<end && ft_isSpace(*p)) {
+        p++;
+    }
+    if(p<end && (*p=='-' || *p=='+')) {
+        negative = (*p=='-');
+        p++;
+    }
+    if(p<end && *p>='0' && *p<='9') {
+        while(p<end && *p>='0' && *p<='9') {
+            magnitude = magnitude*10 + (*p-'0');
+            p++;
+        }
+        *value = negative ? -magnitude : magnitude;
+        *cursor = p;
+        retval = 1;
+    }
+    return retval;
+}
+
+/*
+ * Reads the next text command starting at *cursor into command, leaving
+ * *cursor just past it. Commands are told apart by length and first
+ * byte before a single memcmp. As with scanf in the interactive loop, a
+ * missing or non-numeric argument leaves command->argument unchanged
+ * and the offending token is read as the next command. init may be
+ * followed on the same line by a placement policy, stored in
+ * command->policy (-1 if unknown); the rest of that line is skipped. A
+ * freebatch with a positive count reads up to that many addresses into
+ * extras, stopping at the first token that is not a number. resize
+ * and allocate_aligned always have one extra, the new size or the
+ * alignment, which is 0 when missing.
+ */
+static int ft_nextTextCommand(const char **cursor, const char *end, TraceCommand *command) {
+    int op = FT_OP_END;
+    const char *token;
+    const char *p = *cursor;
+    size_t length;
+    long value;
+    int needsArgument;
+    char word[FT_POLICY_NAME_BYTES];
+    
+    command->extraCount = 0;
+    while(p<end && ft_isSpace(*p)) {
+        p++;
+    }
+    
+    if(p<end) {
+        token = p;
+        while(p<end && !ft_isSpace(*p)) {
+            p++;
+        }
+        length = (size_t) (p-token);
+        
+        op = FT_OP_UNKNOWN;
+        switch(token[0]) {
+            case 'i':
+                if(length==4 && memcmp(token, "init", 4)==0) op = FT_OP_INIT;
+                break;
+            case 'a':
+                if(length==8 && memcmp(token, "allocate", 8)==0) op = FT_OP_ALLOCATE;
+                else if(length==16 && memcmp(token, "allocate_aligned", 16)==0) op = FT_OP_ALLOCATE_ALIGNED;
+                break;
+            case 'f':
+                if(length==4 && memcmp(token, "free", 4)==0) op = FT_OP_FREE;
+                else if(length==9 && memcmp(token, "freebatch", 9)==0) op = FT_OP_FREEBATCH;
+                break;
+            case 'r':
+                if(length==6 && memcmp(token, "resize", 6)==0) op = FT_OP_RESIZE;
+                break;
+            case 'p':
+                if(length==5 && memcmp(token, "print", 5)==0) op = FT_OP_PRINT;
+                break;
+            case 's':
+                if(length==5 && memcmp(token, "stats", 5)==0) op = FT_OP_STATS;
+                break;
+        }
+        
+        needsArgument = (op==FT_OP_INIT || op==FT_OP_ALLOCATE || op==FT_OP_FREE || op==FT_OP_FREEBATCH ||
+                         op==FT_OP_RESIZE || op==FT_OP_ALLOCATE_ALIGNED);
+        if(needsArgument) {
+            ft_readNumber(&p, end, &command->argument);
+        }
+        
+        if(op==FT_OP_RESIZE || op==FT_OP_ALLOCATE_ALIGNED) {
+            value = 0;
+            ft_readNumber(&p, end, &value);
+            ft_addExtra(command, value);
+        } else if(op==FT_OP_FREEBATCH) {
+            while(command->extraCount<command->argument && ft_readNumber(&p, end, &value)) {
+                ft_addExtra(command, value);
+            }
+        } else if(op==FT_OP_INIT) {
+            while(p<end && (*p==' ' || *p=='\t')) {
+                p++;
+            }
+            token = p;
+            while(p<end && !ft_isSpace(*p)) {
+                p++;
+            }
+            length = (size_t) (p-token);
+            if(length==0) {
+                command->policy = FML_POLICY_BESTFIT;
+            } else if(length<sizeof(word)) {
+                memcpy(word, token, length);
+                word[length] = '\0';
+                command->policy = lookupPolicy(word);
+            } else {
+                command->policy = -1;
+            }
+            while(p<end && *p!='\n') {
+                p++;
+            }
+        }
+    }
+    
+    *cursor = p;
+    command->op = op;
+    return op;
+}
+
+/*
+ * Reads the binary record at cursor, and the FT_OP_ARGUMENT records
+ * following it, into command. Returns where the next command starts.
+ */
+static const char *ft_nextBinaryCommand(const char *cursor, const char *end, TraceCommand *command) {
+    int64_t wideArgument;
+    int policyBits = ((unsigned char) cursor[0]) >> FT_POLICY_SHIFT;
+    
+    command->op = ((unsigned char) cursor[0]) & FT_OP_MASK;
+    command->policy = (policyBits<FML_POLICY_COUNT ? policyBits : -1);
+    memcpy(&wideArgument, cursor+1, sizeof(wideArgument));
+    command->argument = (long) wideArgument;
+    command->extraCount = 0;
+    if(command->op==FT_OP_ARGUMENT) {
+        command->op = FT_OP_UNKNOWN;
+    }
+    
+    for(cursor+=FT_RECORD_BYTES;
+        end-cursor>=FT_RECORD_BYTES && (((unsigned char) cursor[0]) & FT_OP_MASK)==FT_OP_ARGUMENT;
+        cursor+=FT_RECORD_BYTES) {
+        memcpy(&wideArgument, cursor+1, sizeof(wideArgument));
+        ft_addExtra(command, (long) wideArgument);
+    }
+    return cursor;
+}
+
+static void ft_printBlock(long start, long end, void *param) {
+    TraceWriter *writer = param;
+    ft_writeLong(writer, start);
+    ft_writeLiteral(writer, "-");
+    ft_writeLong(writer, end);
+    ft_writeLiteral(writer, " (size ");
+    ft_writeLong(writer, (end-start)+1);
+    ft_writeLiteral(writer, ")\n");
+}
+
+/*
+ * Frees a freebatch's addresses with one performFreeBatch, replying to
+ * each as free would.
+ */
+static void ft_freeBatch(fmlArena *arena, TraceWriter *writer, TraceCommand *command) {
+    int *results = malloc((size_t) (command->extraCount>0 ? command->extraCount : 1)*sizeof(*results));
+    long i;
+    
+    if(command->argument<=0 || results==NULL) {
+        ft_writeLiteral(writer, "error, bad batch size\n\n");
+    } else {
+        performFreeBatch(arena, command->extras, command->extraCount, results);
+        for(i=0;i<command->extraCount;i++) {
+            if(results[i]) {
+                ft_writeLiteral(writer, "ok\n\n");
+            } else {
+                ft_writeLiteral(writer, "error, not an allocated block\n\n");
+            }
+        }
+    }
+    free(results);
+}
+
+static void ft_execute(fmlArena *arena, TraceWriter *writer, TraceCommand *command) {
+    long acquiredAddress=0;
+    long argument = command->argument;
+    long second = (command->extraCount>0 ? command->extras[0] : 0);
+    int policy = command->policy;
+    int status;
+    switch(command->op) {
+        case FT_OP_INIT:
+            if(policy<0) {
+                ft_writeLiteral(writer, "error, unknown placement policy\n\n");
+            } else if((status = initializeFml(arena, argument, policy))==FML_ERR_BAD_SIZE) {
+                ft_writeLiteral(writer, "error, bad size\n\n");
+            } else if(status!=FML_SUCCESS) {
+                ft_writeLiteral(writer, "error, cannot allocate ");
+                ft_writeLong(writer, argument);
+                ft_writeLiteral(writer, " blocks\n\n");
+            } else {
+                ft_writeLiteral(writer, "Initialization complete\n\n");
+            }
+            break;
+        case FT_OP_ALLOCATE:
+            if(performAllocation(arena, argument, &acquiredAddress)) {
+                ft_writeLiteral(writer, "your address is ");
+                ft_writeLong(writer, acquiredAddress);
+                ft_writeLiteral(writer, "\n\n");
+            } else {
+                ft_writeLiteral(writer, "error, no contiguous available\n\n");
+            }
+            break;
+        case FT_OP_ALLOCATE_ALIGNED:
+            if(second<=0 || (second & (second-1))!=0) {
+                ft_writeLiteral(writer, "error, alignment must be a power of two\n\n");
+            } else if(performAlignedAllocation(arena, argument, second, &acquiredAddress)) {
+                ft_writeLiteral(writer, "your address is ");
+                ft_writeLong(writer, acquiredAddress);
+                ft_writeLiteral(writer, "\n\n");
+            } else {
+                ft_writeLiteral(writer, "error, no contiguous available\n\n");
+            }
+            break;
+        case FT_OP_FREE:
+            if(performFree(arena, argument)) {
+                ft_writeLiteral(writer, "ok\n\n");
+            } else {
+                ft_writeLiteral(writer, "error, not an allocated block\n\n");
+            }
+            break;
+        case FT_OP_RESIZE:
+            if(allocationBlocks(arena, argument)==0) {
+                ft_writeLiteral(writer, "error, not an allocated block\n\n");
+            } else if(second<=0) {
+                ft_writeLiteral(writer, "error, bad size\n\n");
+            } else if(performResize(arena, argument, second, &acquiredAddress)) {
+                ft_writeLiteral(writer, "your address is ");
+                ft_writeLong(writer, acquiredAddress);
+                ft_writeLiteral(writer, "\n\n");
+            } else {
+                ft_writeLiteral(writer, "error, no contiguous available\n\n");
+            }
+            break;
+        case FT_OP_FREEBATCH:
+            ft_freeBatch(arena, writer, command);
+            break;
+        case FT_OP_PRINT:
+            ft_writeLiteral(writer, "Free memory:\n\n");
+            mapFmlBlocks(arena, 1, writer, ft_printBlock);
+            ft_writeLiteral(writer, "\nUsed memory:\n\n");
+            mapFmlBlocks(arena, 0, writer, ft_printBlock);
+            break;
+        case FT_OP_STATS:
+            ft_flush(writer);
+            printFmlStats(arena, writer->out);
+            break;
+        default:
+            ft_writeLiteral(writer, "Invalid command. Try again.\n\n");
+    }
+}
+
+static int ft_isBinary(TraceInput *input) {
+    return input->length>=FT_MAGIC_BYTES && memcmp(input->data, FT_MAGIC, FT_MAGIC_BYTES)==0;
+}
+
+int ft_runTrace(const char *path, FILE *out, int dumpStats) {
+    int retval;
+    TraceInput input;
+    TraceWriter *writer;
+    fmlArena arena = {0};
+    TraceCommand command = {0};
+    const char *cursor;
+    const char *end;
+    
+    writer = malloc(sizeof(*writer));
+    if(writer==NULL) {
+        retval = FT_ERR_WRITE_FAILED;
+    } else if((retval = ft_openInput(path, &input))==FT_SUCCESS) {
+        writer->out = out;
+        writer->used = 0;
+        writer->failed = 0;
+        end = input.data+input.length;
+        
+        if(ft_isBinary(&input)) {
+            if((input.length-FT_MAGIC_BYTES) % FT_RECORD_BYTES != 0) {
+                retval = FT_ERR_BAD_TRACE;
+            }
+            for(cursor=input.data+FT_MAGIC_BYTES; end-cursor>=FT_RECORD_BYTES;) {
+                cursor = ft_nextBinaryCommand(cursor, end, &command);
+                ft_execute(&arena, writer, &command);
+            }
+        } else {
+            command.policy = FML_POLICY_BESTFIT;
+            cursor = input.data;
+            while(ft_nextTextCommand(&cursor, end, &command)!=FT_OP_END) {
+                ft_execute(&arena, writer, &command);
+            }
+        }
+        
+        ft_flush(writer);
+        if(dumpStats) {
+            printFmlStats(&arena, out);
+        }
+        if(writer->failed || fflush(out)!=0) {
+            retval = FT_ERR_WRITE_FAILED;
+        }
+        ft_closeInput(&input);
+        destroyFml(&arena);
+    }
+    free(command.extras);
+    free(writer);
+    
+    return retval;
+}
+
+static void ft_writeRecord(TraceWriter *writer, char record[FT_RECORD_BYTES], int op, long argument) {
+    int64_t wideArgument = argument;
+    record[0] = (char) op;
+    memcpy(record+1, &wideArgument, sizeof(wideArgument));
+    ft_write(writer, record, FT_RECORD_BYTES);
+}
+
+int ft_compileTrace(const char *textPath, const char *binaryPath) {
+    int retval;
+    TraceInput input;
+    TraceWriter *writer;
+    FILE *out;
+    TraceCommand command = {0};
+    const char *cursor;
+    const char *end;
+    int op;
+    long i;
+    char record[FT_RECORD_BYTES];
+    
+    writer = malloc(sizeof(*writer));
+    if(writer==NULL) {
+        retval = FT_ERR_WRITE_FAILED;
+    } else if((retval = ft_openInput(textPath, &input))==FT_SUCCESS) {
+        out = fopen(binaryPath, "wb");
+        if(out==NULL) {
+            retval = FT_ERR_OPEN_FAILED;
+        } else {
+            writer->out = out;
+            writer->used = 0;
+            writer->failed = 0;
+            ft_write(writer, FT_MAGIC, FT_MAGIC_BYTES);
+            
+            command.policy = FML_POLICY_BESTFIT;
+            cursor = input.data;
+            end = input.data+input.length;
+            while((op = ft_nextTextCommand(&cursor, end, &command))!=FT_OP_END) {
+                if(op!=FT_OP_UNKNOWN) {
+                    if(op==FT_OP_INIT) {
+                        op |= (command.policy<0 ? FT_OP_MASK : command.policy) << FT_POLICY_SHIFT;
+                    }
+                    ft_writeRecord(writer, record, op, (op==FT_OP_PRINT || op==FT_OP_STATS ? 0 : command.argument));
+                    for(i=0;i<command.extraCount;i++) {
+                        ft_writeRecord(writer, record, FT_OP_ARGUMENT, command.extras[i]);
+                    }
+                }
+            }
+            
+            ft_flush(writer);
+            if(fclose(out)!=0 || writer->failed) {
+                retval = FT_ERR_WRITE_FAILED;
+            }
+        }
+        ft_closeInput(&input);
+    }
+    free(command.extras);
+    free(writer);
+    
+    return retval;
+}
@@ -0,0 +1,66 @@
+//
+//  fmltrace.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/9/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_fmltrace_h
+#define freememlist_fmltrace_h
+
+#include <stdio.h>
+
+#define FT_SUCCESS 0
+#define FT_ERR_OPEN_FAILED 1
+#define FT_ERR_BAD_TRACE 2
+#define FT_ERR_WRITE_FAILED 3
+
+/*
+ * A binary trace is FT_MAGIC followed by fixed FT_RECORD_BYTES records:
+ * one opcode byte and a 64-bit argument in host byte order. Opcodes
+ * match the text commands; PRINT and STATS ignore their argument. The high nibble
+ * of an INIT opcode carries the FML_POLICY_ placement policy (0 is
+ * bestfit, FT_OP_MASK an unknown name). Arguments after the first
+ * follow their command as FT_OP_ARGUMENT records, one per argument: a
+ * FREEBATCH record holds the count typed and is followed by the
+ * addresses actually read; a RESIZE record holds the address and is
+ * followed by the new size, and an ALLOCATE_ALIGNED record holds the
+ * size and is followed by the alignment.
+ */
+#define FT_MAGIC "FMLT"
+#define FT_MAGIC_BYTES 4
+#define FT_RECORD_BYTES 9
+
+#define FT_OP_INIT 1
+#define FT_OP_ALLOCATE 2
+#define FT_OP_FREE 3
+#define FT_OP_PRINT 4
+#define FT_OP_STATS 5
+#define FT_OP_FREEBATCH 6
+#define FT_OP_RESIZE 7
+#define FT_OP_ALLOCATE_ALIGNED 8
+#define FT_OP_ARGUMENT 15
+
+#define FT_OP_MASK 0x0f
+#define FT_POLICY_SHIFT 4
+
+/*
+ * Replays the trace at path (or standard input for "-") against a fresh
+ * arena and writes the same replies the interactive loop would, minus
+ * the prompts, to out. A file starting with FT_MAGIC is read as a
+ * binary trace, anything else as the text commands, with decimal
+ * arguments. The input is memory-mapped when possible and all output
+ * goes through one buffer, flushed only when full and at the end.
+ * With dumpStats non-zero the arena's statistics are written after the
+ * last command.
+ */
+int ft_runTrace(const char *path, FILE *out, int dumpStats);
+
+/*
+ * Converts the text trace at textPath into a binary trace at
+ * binaryPath. Unknown commands are dropped.
+ */
+int ft_compileTrace(const char *textPath, const char *binaryPath);
+
+#endif
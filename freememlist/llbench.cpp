@@ -0,0 +1,475 @@
+//
+//  llbench.cpp
+//  freememlist
+//
+//  Created by Kevin Carter on 8/4/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+#include "llist.h"
+#include "llist.hpp"
+#include "ulist.h"
+
+/*
+ * Runs the same list workloads through the C API and through
+ * ll::List and reports the time each took. Keys are random longs; the C
+ * lists store them directly in LinkedListEntry.data so neither side
+ * allocates anything but nodes. Each workload ends with a checksum of
+ * the list contents from both sides, which must agree.
+ *
+ *   sortedInsert  n appends to a list sorted by key
+ *   sort          re-sorting n unsorted keys
+ *   search        m searches for keys in an unsorted list of n
+ *   map           ten passes adding one to every key
+ *   filter        removing every key divisible by three
+ *   drain         polling every key off the head
+ *
+ * search, map, filter and drain also run through an UnrolledList
+ * (ulist.h) holding the same keys, reported as ulNanos and ulSpeedup
+ * (cNanos/ulNanos); its checksum must agree too. The other workloads
+ * have no UnrolledList equivalent and report ulNanos as -1 (null in
+ * JSON).
+ *
+ * Results go to stdout or -o as JSON, or as CSV with -f csv, where a
+ * header row is only written to an empty file so runs can be appended
+ * and compared, as with fmlbench. -t attaches a label to the rows.
+ */
+
+#define BENCH_MAP_PASSES 10
+#define BENCH_NO_UL -1
+
+typedef struct benchConfig {
+    long keys;
+    long searches;
+    unsigned long seed;
+    int csv;
+    const char *outputPath;
+    const char *label;
+} benchConfig;
+
+typedef struct benchResult {
+    const char *workload;
+    long cNanos;
+    long cppNanos;
+    long ulNanos;
+    int checksumsMatch;
+} benchResult;
+
+typedef std::chrono::steady_clock benchClock;
+typedef ll::List<long> UnorderedList;
+typedef ll::List<long, std::less<long> > SortedList;
+
+static long benchNanosSince(benchClock::time_point started) {
+    return (long) std::chrono::duration_cast<std::chrono::nanoseconds>(benchClock::now()-started).count();
+}
+
+static unsigned long benchRandom(unsigned long *state) {
+    unsigned long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return x;
+}
+
+static long keyOf(void *data) {
+    return (long) (intptr_t) data;
+}
+
+static int compareKeys(void *a, void *b) {
+    long left = keyOf(a);
+    long right = keyOf(b);
+    return (left>right) - (left<right);
+}
+
+static int keyEquals(void *data, void *key) {
+    return keyOf(data)==*(long *) key;
+}
+
+static void *addOne(void *data, void *param) {
+    (void) param;
+    return (void *) (intptr_t) (keyOf(data)+1);
+}
+
+static int divisibleByThree(void *data, void *param) {
+    (void) param;
+    return keyOf(data)%3==0;
+}
+
+/*
+ * Order-sensitive, so two lists only agree if they hold the same keys
+ * in the same order.
+ */
+static unsigned long checksumC(LinkedList *list) {
+    unsigned long retval = 0;
+    LinkedListEntry *entry;
+    for(entry=list->first;entry!=NULL;entry=entry->next) {
+        retval = retval*1000003UL + (unsigned long) keyOf(entry->data);
+    }
+    return retval;
+}
+
+static unsigned long checksumUl(UnrolledList *list) {
+    unsigned long retval = 0;
+    UnrolledListNode *node;
+    long i;
+    for(node=list->first;node!=NULL;node=node->next) {
+        for(i=0;i<node->count;i++) {
+            retval = retval*1000003UL + (unsigned long) keyOf(node->data[i]);
+        }
+    }
+    return retval;
+}
+
+template <typename ListType>
+static unsigned long checksumCpp(const ListType &list) {
+    unsigned long retval = 0;
+    for(typename ListType::const_iterator i=list.begin();i!=list.end();++i) {
+        retval = retval*1000003UL + (unsigned long) *i;
+    }
+    return retval;
+}
+
+static LinkedList *fillC(long *keys, long count) {
+    LinkedList *list = ll_create();
+    long i;
+    for(i=0;i<count;i++) {
+        ll_append(list, (void *) (intptr_t) keys[i]);
+    }
+    return list;
+}
+
+static UnrolledList *fillUl(long *keys, long count) {
+    UnrolledList *list = ul_create();
+    long i;
+    for(i=0;i<count;i++) {
+        ul_append(list, (void *) (intptr_t) keys[i]);
+    }
+    return list;
+}
+
+static void fillCpp(UnorderedList &list, long *keys, long count) {
+    long i;
+    for(i=0;i<count;i++) {
+        list.append(keys[i]);
+    }
+}
+
+static benchResult benchSortedInsert(long *keys, long count) {
+    benchResult result = {"sortedInsert", 0, 0, BENCH_NO_UL, 0};
+    LinkedList *cList = ll_create();
+    SortedList cppList;
+    benchClock::time_point started;
+    long i;
+
+    ll_assignKeySortFunction(cList, compareKeys);
+    started = benchClock::now();
+    for(i=0;i<count;i++) {
+        ll_append(cList, (void *) (intptr_t) keys[i]);
+    }
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    for(i=0;i<count;i++) {
+        cppList.append(keys[i]);
+    }
+    result.cppNanos = benchNanosSince(started);
+
+    result.checksumsMatch = checksumC(cList)==checksumCpp(cppList);
+    ll_destroy(cList, NULL);
+    return result;
+}
+
+static benchResult benchSort(long *keys, long count) {
+    benchResult result = {"sort", 0, 0, BENCH_NO_UL, 0};
+    LinkedList *cList = fillC(keys, count);
+    UnorderedList cppList;
+    benchClock::time_point started;
+
+    fillCpp(cppList, keys, count);
+    started = benchClock::now();
+    ll_assignKeySortFunction(cList, compareKeys);
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    cppList.sort(std::less<long>());
+    result.cppNanos = benchNanosSince(started);
+
+    result.checksumsMatch = checksumC(cList)==checksumCpp(cppList);
+    ll_destroy(cList, NULL);
+    return result;
+}
+
+static benchResult benchSearch(long *keys, long count, long searches, unsigned long *state) {
+    benchResult result = {"search", 0, 0, 0, 0};
+    LinkedList *cList = fillC(keys, count);
+    UnrolledList *ulList = fillUl(keys, count);
+    UnorderedList cppList;
+    long *targets = (long *) malloc(sizeof(long)*searches);
+    unsigned long cFound = 0;
+    unsigned long cppFound = 0;
+    unsigned long ulFound = 0;
+    benchClock::time_point started;
+    LinkedListEntry *entry;
+    long *found;
+    void *data;
+    long foundIndex;
+    long target;
+    long i;
+
+    fillCpp(cppList, keys, count);
+    for(i=0;i<searches;i++) {
+        targets[i] = keys[benchRandom(state) % (unsigned long) count];
+    }
+
+    started = benchClock::now();
+    for(i=0;i<searches;i++) {
+        if((entry = ll_search(cList, &targets[i], keyEquals))!=NULL) {
+            cFound += (unsigned long) keyOf(entry->data);
+        }
+    }
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    for(i=0;i<searches;i++) {
+        target = targets[i];
+        if((found = cppList.search([target](long key) { return key==target; }))!=nullptr) {
+            cppFound += (unsigned long) *found;
+        }
+    }
+    result.cppNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    for(i=0;i<searches;i++) {
+        data = ul_search(ulList, &targets[i], keyEquals, &foundIndex);
+        if(foundIndex>=0) {
+            ulFound += (unsigned long) keyOf(data);
+        }
+    }
+    result.ulNanos = benchNanosSince(started);
+
+    result.checksumsMatch = cFound==cppFound && cFound==ulFound;
+    ll_destroy(cList, NULL);
+    ul_destroy(ulList, NULL);
+    free(targets);
+    return result;
+}
+
+static benchResult benchMap(long *keys, long count) {
+    benchResult result = {"map", 0, 0, 0, 0};
+    LinkedList *cList = fillC(keys, count);
+    UnrolledList *ulList = fillUl(keys, count);
+    UnorderedList cppList;
+    benchClock::time_point started;
+    int pass;
+
+    fillCpp(cppList, keys, count);
+    started = benchClock::now();
+    for(pass=0;pass<BENCH_MAP_PASSES;pass++) {
+        ll_mapInline(cList, NULL, addOne);
+    }
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    for(pass=0;pass<BENCH_MAP_PASSES;pass++) {
+        cppList.mapInline([](long key) { return key+1; });
+    }
+    result.cppNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    for(pass=0;pass<BENCH_MAP_PASSES;pass++) {
+        ul_mapInline(ulList, NULL, addOne);
+    }
+    result.ulNanos = benchNanosSince(started);
+
+    result.checksumsMatch = checksumC(cList)==checksumCpp(cppList) && checksumC(cList)==checksumUl(ulList);
+    ll_destroy(cList, NULL);
+    ul_destroy(ulList, NULL);
+    return result;
+}
+
+static benchResult benchFilter(long *keys, long count) {
+    benchResult result = {"filter", 0, 0, 0, 0};
+    LinkedList *cList = fillC(keys, count);
+    UnrolledList *ulList = fillUl(keys, count);
+    UnorderedList cppList;
+    benchClock::time_point started;
+
+    fillCpp(cppList, keys, count);
+    started = benchClock::now();
+    ll_filterInline(cList, NULL, divisibleByThree);
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    cppList.filterInline([](long key) { return key%3==0; });
+    result.cppNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    ul_filterInline(ulList, NULL, divisibleByThree);
+    result.ulNanos = benchNanosSince(started);
+
+    result.checksumsMatch = checksumC(cList)==checksumCpp(cppList) && checksumC(cList)==checksumUl(ulList);
+    ll_destroy(cList, NULL);
+    ul_destroy(ulList, NULL);
+    return result;
+}
+
+static benchResult benchDrain(long *keys, long count) {
+    benchResult result = {"drain", 0, 0, 0, 0};
+    LinkedList *cList = fillC(keys, count);
+    UnrolledList *ulList = fillUl(keys, count);
+    UnorderedList cppList;
+    unsigned long cSum = 0;
+    unsigned long cppSum = 0;
+    unsigned long ulSum = 0;
+    benchClock::time_point started;
+    long key;
+
+    fillCpp(cppList, keys, count);
+    started = benchClock::now();
+    while(cList->first!=NULL) {
+        cSum = cSum*31UL + (unsigned long) keyOf(ll_poll(cList));
+    }
+    result.cNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    while(cppList.poll(key)) {
+        cppSum = cppSum*31UL + (unsigned long) key;
+    }
+    result.cppNanos = benchNanosSince(started);
+
+    started = benchClock::now();
+    while(ulList->elementCount>0) {
+        ulSum = ulSum*31UL + (unsigned long) keyOf(ul_poll(ulList));
+    }
+    result.ulNanos = benchNanosSince(started);
+
+    result.checksumsMatch = cSum==cppSum && cSum==ulSum;
+    ll_destroy(cList, NULL);
+    ul_destroy(ulList, NULL);
+    return result;
+}
+
+static double benchSpeedup(long nanos, long otherNanos) {
+    return otherNanos>0 ? (double) nanos/otherNanos : 0.0;
+}
+
+static void benchReport(benchConfig *config, benchResult *results, int count, FILE *out, int writeHeader) {
+    char ulNanos[24];
+    char ulSpeedup[24];
+    int i;
+
+    if(config->csv) {
+        if(writeHeader) {
+            fprintf(out, "label,workload,keys,searches,seed,cNanos,cppNanos,speedup,ulNanos,ulSpeedup,checksumsMatch\n");
+        }
+        for(i=0;i<count;i++) {
+            fprintf(out, "%s,%s,%li,%li,%lu,%li,%li,%.3f,%li,%.3f,%d\n",
+                    config->label, results[i].workload, config->keys, config->searches, config->seed,
+                    results[i].cNanos, results[i].cppNanos, benchSpeedup(results[i].cNanos, results[i].cppNanos),
+                    results[i].ulNanos, benchSpeedup(results[i].cNanos, results[i].ulNanos),
+                    results[i].checksumsMatch);
+        }
+    } else {
+        fprintf(out, "{\n");
+        fprintf(out, "  \"label\": \"%s\",\n", config->label);
+        fprintf(out, "  \"config\": {\"keys\": %li, \"searches\": %li, \"seed\": %lu},\n",
+                config->keys, config->searches, config->seed);
+        fprintf(out, "  \"workloads\": [\n");
+        for(i=0;i<count;i++) {
+            if(results[i].ulNanos==BENCH_NO_UL) {
+                strcpy(ulNanos, "null");
+                strcpy(ulSpeedup, "null");
+            } else {
+                snprintf(ulNanos, sizeof(ulNanos), "%li", results[i].ulNanos);
+                snprintf(ulSpeedup, sizeof(ulSpeedup), "%.3f", benchSpeedup(results[i].cNanos, results[i].ulNanos));
+            }
+            fprintf(out, "    {\"workload\": \"%s\", \"cNanos\": %li, \"cppNanos\": %li, \"speedup\": %.3f, "
+                    "\"ulNanos\": %s, \"ulSpeedup\": %s, \"checksumsMatch\": %s}%s\n",
+                    results[i].workload, results[i].cNanos, results[i].cppNanos,
+                    benchSpeedup(results[i].cNanos, results[i].cppNanos), ulNanos, ulSpeedup,
+                    results[i].checksumsMatch ? "true" : "false", i+1<count ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+}
+
+static void benchUsage(const char *name) {
+    fprintf(stderr, "usage: %s [-n keys] [-m searches] [-r seed] [-f json|csv] [-o file] [-t label]\n", name);
+}
+
+int main(int argc, const char * argv[])
+{
+    benchConfig config = {10000, 2000, 1, 0, NULL, ""};
+    benchResult results[6];
+    FILE *out = stdout;
+    int writeHeader = 1;
+    unsigned long state;
+    long *keys;
+    long i;
+    int r;
+    int allMatch = 1;
+
+    for(r=1;r<argc;r++) {
+        if(r+1>=argc || argv[r][0]!='-' || strlen(argv[r])!=2) {
+            benchUsage(argv[0]);
+            return 1;
+        }
+        switch(argv[r][1]) {
+            case 'n': config.keys = atol(argv[++r]); break;
+            case 'm': config.searches = atol(argv[++r]); break;
+            case 'r': config.seed = strtoul(argv[++r], NULL, 0); break;
+            case 'o': config.outputPath = argv[++r]; break;
+            case 't': config.label = argv[++r]; break;
+            case 'f': config.csv = strcmp(argv[++r], "csv")==0; break;
+            default:
+                benchUsage(argv[0]);
+                return 1;
+        }
+    }
+
+    if(config.keys<1 || config.searches<0) {
+        benchUsage(argv[0]);
+        return 1;
+    }
+
+    if(config.outputPath!=NULL) {
+        out = fopen(config.outputPath, config.csv ? "a" : "w");
+        if(out==NULL) {
+            perror(config.outputPath);
+            return 1;
+        }
+        writeHeader = ftell(out)==0;
+    }
+
+    state = config.seed ? config.seed : 1;
+    keys = (long *) malloc(sizeof(long)*config.keys);
+    for(i=0;i<config.keys;i++) {
+        keys[i] = (long) (benchRandom(&state) % (unsigned long) (config.keys*4));
+    }
+
+    results[0] = benchSortedInsert(keys, config.keys);
+    results[1] = benchSort(keys, config.keys);
+    results[2] = benchSearch(keys, config.keys, config.searches, &state);
+    results[3] = benchMap(keys, config.keys);
+    results[4] = benchFilter(keys, config.keys);
+    results[5] = benchDrain(keys, config.keys);
+    benchReport(&config, results, 6, out, writeHeader);
+
+    for(r=0;r<6;r++) {
+        allMatch = allMatch && results[r].checksumsMatch;
+    }
+
+    free(keys);
+    if(out!=stdout) {
+        fclose(out);
+    }
+
+    return allMatch ? 0 : 2;
+}
@@ -9,48 +9,292 @@
 #include <stddef.h>
 #include <memory.h>
 #include "llist.h"
+#include "slab.h"
 
+#ifdef LL_THREAD_SAFE
+#include <pthread.h>
 
+#define LL_LOCK(list) pthread_mutex_lock(&(list)->lock)
+#define LL_UNLOCK(list) pthread_mutex_unlock(&(list)->lock)
+#else
+#define LL_LOCK(list) ((void)(list))
+#define LL_UNLOCK(list) ((void)(list))
+#endif
+
+#ifdef LL_STATS
+static LinkedListStats ll_stats;
+static long ll_liveEntries();
+
+#ifdef LL_THREAD_SAFE
+#define LL_STAT(field, amount) __atomic_fetch_add(&ll_stats.field, (amount), __ATOMIC_RELAXED)
+#else
+#define LL_STAT(field, amount) (ll_stats.field += (amount))
+#endif
+
+void ll_getStats(LinkedListStats *stats) {
+    memcpy(stats, &ll_stats, sizeof(*stats));
+    stats->liveEntries = ll_liveEntries();
+}
+
+void ll_resetStats() {
+    memset(&ll_stats, 0, sizeof(ll_stats));
+}
+#else
+/* amount is still evaluated, so counts kept only for the stats are not unused */
+#define LL_STAT(field, amount) ((void)(amount))
+#endif
 
 static int ll_link(LinkedList *list, LinkedListEntry *newentry, LinkedListEntry *previousEntry, LinkedListEntry *nextEntry);
 static int ll_unlink(LinkedListEntry *entryToUnlink);
+static LinkedListEntry *ll_skipPlace(LinkedList *list, LinkedListEntry *newEntry);
+static void ll_relinkSkipLanes(LinkedList *list);
+static int ll_randomSkipHeight(LinkedList *list);
+static void ll_disableSkipList(LinkedList *list);
 
 
 
-#ifdef LL_STATIC_ALLOCATION
+#ifndef LL_SYSTEM_ALLOCATION
 
-#ifndef NUM_USER_ENTRIES
-#define NUM_USER_ENTRIES 150
+static SlabPool entryPool={0};
+static SlabPool listPool={0};
+
+static void ll_initializePools() {
+    slab_initialize(&entryPool, sizeof(LinkedListEntry));
+    slab_initialize(&listPool, sizeof(LinkedList));
+}
+
+#ifdef LL_THREAD_SAFE
+
+/*
+ * Entries are handed out from a small per-thread cache so the common
+ * alloc/release path touches no shared state. The cache is refilled
+ * from and drained to the shared pool LL_CACHE_BATCH entries at a time,
+ * which is the only point poolLock is taken. A thread's cache is
+ * returned to the pool when the thread exits.
+ */
+#ifndef LL_CACHE_BATCH
+#define LL_CACHE_BATCH 64
 #endif
 
-#define NUM_LISTS 10
-#define NUM_ENTRIES NUM_USER_ENTRIES + NUM_LISTS
+typedef struct ll_entryCache {
+    void *objects;
+    int count;
+    int registered;
+} ll_entryCache;
 
-LinkedList freeLists={0};
-LinkedList freeEntries={0};
-LinkedList lists[10]={0};
+static pthread_mutex_t poolLock=PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t poolsInitialized=PTHREAD_ONCE_INIT;
+static pthread_key_t cacheKey;
+static __thread ll_entryCache entryCache;
 
-LinkedListEntry entries[NUM_ENTRIES]={0};
+#define LL_POOL_LOCK() pthread_mutex_lock(&poolLock)
+#define LL_POOL_UNLOCK() pthread_mutex_unlock(&poolLock)
 
-int initializeFreeList() {
+static void ll_drainCache(ll_entryCache *cache, int keep) {
+    void *object;
+    LL_POOL_LOCK();
+    while(cache->count>keep) {
+        object=cache->objects;
+        cache->objects=*(void **)object;
+        cache->count--;
+        slab_free(object);
+    }
+    LL_POOL_UNLOCK();
+}
+
+static void ll_releaseCache(void *cache) {
+    ll_drainCache(cache, 0);
+}
+
+/*
+ * Arranges for cache to be drained when the thread exits. Called before
+ * anything is put into the cache, whether by a refill or by a thread
+ * that only releases entries allocated elsewhere.
+ */
+static void ll_registerCache(ll_entryCache *cache) {
+    if(!cache->registered) {
+        pthread_setspecific(cacheKey, cache);
+        cache->registered=1;
+    }
+}
+
+static void ll_refillCache(ll_entryCache *cache) {
+    void *object;
     int i;
-    int retval=LL_SUCCESS;
     
-    for(i=0;i<NUM_ENTRIES && retval == LL_SUCCESS;i++) {
-        retval = ll_link(&freeEntries,&entries[i],(i>0?&entries[i-1]:NULL),NULL);
+    ll_registerCache(cache);
+    LL_POOL_LOCK();
+    for(i=0;i<LL_CACHE_BATCH && (object=slab_alloc(&entryPool))!=NULL;i++) {
+        *(void **)object=cache->objects;
+        cache->objects=object;
+        cache->count++;
     }
+    LL_POOL_UNLOCK();
+}
+
+static void ll_initializePoolsOnce() {
+    pthread_key_create(&cacheKey, ll_releaseCache);
+    ll_initializePools();
+}
+
+int initializeFreeList() {
+    pthread_once(&poolsInitialized, ll_initializePoolsOnce);
+    return (entryPool.objectSize!=0 && listPool.objectSize!=0) ? LL_SUCCESS : LL_ERR_FREELISTS_INIT_FAILED;
+}
+
+static LinkedListEntry *ll_poolAllocEntry() {
+    LinkedListEntry *retval=NULL;
     
-    freeEntries.first=&entries[0];
-    freeEntries.last=&entries[NUM_ENTRIES-1];
-    
-    for(i=0;i<NUM_LISTS;i++) {
-        retval = (ll_append(&freeLists,&lists[i])!=NULL ? LL_SUCCESS : LL_ERR_FREELISTS_INIT_FAILED);
+    if(entryCache.count==0 && initializeFreeList()==LL_SUCCESS) {
+        LL_STAT(poolMisses, 1);
+        ll_refillCache(&entryCache);
+    } else {
+        LL_STAT(poolHits, 1);
     }
     
+    if(entryCache.count>0) {
+        retval=entryCache.objects;
+        entryCache.objects=*(void **)retval;
+        entryCache.count--;
+        memset(retval, 0, sizeof(*retval));
+    }
     return retval;
 }
+
+static void ll_poolReleaseEntry(LinkedListEntry *entry) {
+    ll_registerCache(&entryCache);
+    *(void **)entry=entryCache.objects;
+    entryCache.objects=entry;
+    if(++entryCache.count > 2*LL_CACHE_BATCH) {
+        ll_drainCache(&entryCache, LL_CACHE_BATCH);
+    }
+}
+
+void ll_trimPools() {
+    ll_drainCache(&entryCache, 0);
+    LL_POOL_LOCK();
+    slab_trim(&entryPool);
+    slab_trim(&listPool);
+    LL_POOL_UNLOCK();
+}
+
 #else
 
+#define LL_POOL_LOCK()
+#define LL_POOL_UNLOCK()
+
+int initializeFreeList() {
+    if(entryPool.objectSize==0) {
+        ll_initializePools();
+    }
+    return (entryPool.objectSize!=0 && listPool.objectSize!=0) ? LL_SUCCESS : LL_ERR_FREELISTS_INIT_FAILED;
+}
+
+void ll_trimPools() {
+    slab_trim(&entryPool);
+    slab_trim(&listPool);
+}
+#endif
+
+#ifdef LL_STATS
+static long ll_liveEntries() {
+    long retval;
+    LL_POOL_LOCK();
+    retval = entryPool.liveObjects;
+    LL_POOL_UNLOCK();
+    return retval;
+}
+#endif
+
+static void *ll_poolAlloc(SlabPool *pool) {
+    void *retval=NULL;
+#ifdef LL_STATS
+    long slabCount;
+#endif
+    if(initializeFreeList()==LL_SUCCESS) {
+        LL_POOL_LOCK();
+#ifdef LL_STATS
+        slabCount=pool->slabCount;
+#endif
+        retval=slab_alloc(pool);
+#ifdef LL_STATS
+        if(pool->slabCount==slabCount) {
+            LL_STAT(poolHits, 1);
+        } else {
+            LL_STAT(poolMisses, 1);
+        }
+#endif
+        LL_POOL_UNLOCK();
+    }
+    if(retval!=NULL) {
+        memset(retval, 0, pool->objectSize);
+    }
+    return retval;
+}
+
+static void ll_poolFree(void *object) {
+    LL_POOL_LOCK();
+    slab_free(object);
+    LL_POOL_UNLOCK();
+}
+
+/*
+ * Carves count entries from the pool under a single lock and returns
+ * them chained through next, or NULL (having put back any it got) if the
+ * pool could not supply them all. Thread-safe builds go straight to the
+ * shared pool rather than through the thread's cache.
+ */
+static LinkedListEntry *ll_poolAllocChain(long count) {
+    LinkedListEntry *chain=NULL;
+    LinkedListEntry *entry;
+    LinkedListEntry *next;
+    long allocated=0;
+    
+    if(initializeFreeList()==LL_SUCCESS) {
+        LL_POOL_LOCK();
+        for(;allocated<count && (entry=slab_alloc(&entryPool))!=NULL;allocated++) {
+            memset(entry, 0, sizeof(*entry));
+            entry->next=chain;
+            chain=entry;
+        }
+        if(allocated<count) {
+            for(entry=chain;entry!=NULL;entry=next) {
+                next=entry->next;
+                slab_free(entry);
+            }
+            chain=NULL;
+        }
+        LL_POOL_UNLOCK();
+    }
+    return chain;
+}
+
+/*
+ * Returns a chain of entries linked through next to the pool under a
+ * single lock.
+ */
+static void ll_poolReleaseChain(LinkedListEntry *chain) {
+    LinkedListEntry *next;
+    
+    LL_POOL_LOCK();
+    for(;chain!=NULL;chain=next) {
+        next=chain->next;
+        slab_free(chain);
+    }
+    LL_POOL_UNLOCK();
+}
+
+#ifndef LL_THREAD_SAFE
+#define ll_poolAllocEntry() ll_poolAlloc(&entryPool)
+#define ll_poolReleaseEntry(entry) ll_poolFree(entry)
+#endif
+
+#elif defined(LL_STATS)
+
+static long ll_liveEntries() {
+    return __atomic_load_n(&ll_stats.entryAllocs, __ATOMIC_RELAXED) - __atomic_load_n(&ll_stats.entryReleases, __ATOMIC_RELAXED);
+}
+
 #endif
 
 static int ll_link(LinkedList *list, LinkedListEntry *newentry, LinkedListEntry *previousEntry, LinkedListEntry *nextEntry) {
@@ -87,10 +331,40 @@ static int ll_link(LinkedList *list, LinkedListEntry *newentry, LinkedListEntry
     return retval;
 }
 
+static void ll_unlinkSkipTower(LinkedListEntry *entry) {
+    int lane;
+    LinkedList *list=entry->owner;
+    LinkedListSkipLink *link;
+    
+    for(lane=0;lane<entry->skipHeight;lane++) {
+        link=&entry->skipLinks[lane];
+        if(link->previous!=NULL) {
+            link->previous->skipLinks[lane].next=link->next;
+        } else {
+            list->skipFirst[lane]=link->next;
+        }
+        
+        if(link->next!=NULL) {
+            link->next->skipLinks[lane].previous=link->previous;
+        }
+    }
+    
+    while(list->skipLanes>0 && list->skipFirst[list->skipLanes-1]==NULL) {
+        list->skipLanes--;
+    }
+    
+    free(entry->skipLinks);
+    entry->skipLinks=NULL;
+    entry->skipHeight=0;
+}
+
 static int ll_unlink(LinkedListEntry *entryToUnlink) {
     int retval=LL_SUCCESS;
     if(entryToUnlink!=NULL) {
         if(entryToUnlink->owner!=NULL){
+            if(entryToUnlink->skipLinks!=NULL) {
+                ll_unlinkSkipTower(entryToUnlink);
+            }
             entryToUnlink->owner->nodeCount--;
             entryToUnlink->owner=NULL;
             if(entryToUnlink->previous !=NULL) {
@@ -112,60 +386,115 @@ static int ll_unlink(LinkedListEntry *entryToUnlink) {
     return retval;
 }
 
-static LinkedListEntry * ll_allocEntry(void *data) {
+LinkedListEntry * ll_allocEntry(void *data) {
     LinkedListEntry *newNode;
-#ifdef LL_STATIC_ALLOCATION
-    if(freeEntries.first!=NULL) {
-        newNode = freeEntries.first;
-        if((freeEntries.first=freeEntries.first->next)==NULL) {
-            freeEntries.last=NULL;
-        }
-        ll_unlink(newNode);
-    }
+#ifndef LL_SYSTEM_ALLOCATION
+    newNode = ll_poolAllocEntry();
 #else
     newNode= calloc(1,sizeof(*newNode));
 
 #endif
     if(newNode!=NULL){
         newNode->data=data;
+        LL_STAT(entryAllocs, 1);
     }
     return newNode;
 }
 
-static void ll_releaseEntry(LinkedListEntry *entry) {
-#ifdef LL_STATIC_ALLOCATION
-    ll_link(&freeEntries, entry, NULL, freeEntries.first);
-    if(freeEntries.last==NULL) {
-        freeEntries.last=entry;
-    }
+void ll_releaseEntry(LinkedListEntry *entry) {
+    LL_STAT(entryReleases, 1);
+#ifndef LL_SYSTEM_ALLOCATION
+    ll_poolReleaseEntry(entry);
 #else
     free(entry);
 #endif
 }
 
+static LinkedListEntry *ll_allocEntries(long count) {
+    LinkedListEntry *chain;
+#ifndef LL_SYSTEM_ALLOCATION
+    chain = ll_poolAllocChain(count);
+#else
+    LinkedListEntry *entry;
+    long allocated;
+    
+    chain=NULL;
+    for(allocated=0;allocated<count && (entry=calloc(1,sizeof(*entry)))!=NULL;allocated++) {
+        entry->next=chain;
+        chain=entry;
+    }
+    if(allocated<count) {
+        for(;chain!=NULL;chain=entry) {
+            entry=chain->next;
+            free(chain);
+        }
+    }
+#endif
+    if(chain!=NULL) {
+        LL_STAT(entryAllocs, count);
+    }
+    return chain;
+}
+
+static void ll_releaseEntries(LinkedListEntry *chain, long count) {
+    LL_STAT(entryReleases, count);
+#ifndef LL_SYSTEM_ALLOCATION
+    ll_poolReleaseChain(chain);
+#else
+    LinkedListEntry *next;
+    for(;chain!=NULL;chain=next) {
+        next=chain->next;
+        free(chain);
+    }
+#endif
+}
+
 static void ll_releaseList(LinkedList *list) {
-#ifdef LL_STATIC_ALLOCATION
-    ll_append(&freeLists, list);
+#ifdef LL_THREAD_SAFE
+    pthread_mutex_destroy(&list->lock);
+#endif
+#ifndef LL_SYSTEM_ALLOCATION
+    ll_poolFree(list);
 #else
     free(list);
 #endif
 }
 
 LinkedList *ll_create() {
-#ifdef LL_STATIC_ALLOCATION
-    return ll_pop(&freeLists);
+    LinkedList *list;
+#ifdef LL_THREAD_SAFE
+    pthread_mutexattr_t lockAttributes;
+#endif
+#ifndef LL_SYSTEM_ALLOCATION
+    list = ll_poolAlloc(&listPool);
 #else
-    return calloc(1,sizeof(LinkedList));
+    list = calloc(1,sizeof(LinkedList));
+#endif
+#ifdef LL_THREAD_SAFE
+    if(list!=NULL) {
+        /* public functions call each other, so the lock must nest */
+        pthread_mutexattr_init(&lockAttributes);
+        pthread_mutexattr_settype(&lockAttributes, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&list->lock, &lockAttributes);
+        pthread_mutexattr_destroy(&lockAttributes);
+    }
 #endif
+    return list;
 }
 
 LinkedListEntry * ll_search(LinkedList *list, void * searchParam, int (sortCompareFunc)(void *, void *)) {
     LinkedListEntry *entry=NULL;
     
     if(list!=NULL && sortCompareFunc!=NULL){
-        for(entry=list->first;
-            entry!=NULL && !sortCompareFunc(entry->data, searchParam);
-            entry=entry->next);
+        LL_LOCK(list);
+        LL_STAT(searches, 1);
+        for(entry=list->first;entry!=NULL;entry=entry->next) {
+            LL_STAT(searchVisits, 1);
+            if(sortCompareFunc(entry->data, searchParam)) {
+                break;
+            }
+        }
+        LL_UNLOCK(list);
     }
     
     return entry;
@@ -174,11 +503,14 @@ LinkedListEntry * ll_search(LinkedList *list, void * searchParam, int (sortCompa
 LinkedListEntry *ll_append(LinkedList *list,void *data) {
     LinkedListEntry *retval=NULL;
     if(list!=NULL){
-        
-        if(list->first==NULL) {
-            retval=list->first=list->last=ll_allocEntry(data);
-            retval->owner=list;
-            list->nodeCount++;
+        LL_LOCK(list);
+        if(list->skipFirst!=NULL) {
+            retval = ll_insert(list,data);
+        } else if(list->first==NULL) {
+            if((retval=list->first=list->last=ll_allocEntry(data))!=NULL) {
+                retval->owner=list;
+                list->nodeCount++;
+            }
         } else {
             if(list->sortCompareFunc!=NULL){
                 retval = ll_insert(list,data);
@@ -186,7 +518,7 @@ LinkedListEntry *ll_append(LinkedList *list,void *data) {
                 retval = ll_insertAfter(list->last, data);
             }
         }
-        
+        LL_UNLOCK(list);
     }
     return retval;
 }
@@ -194,10 +526,14 @@ LinkedListEntry *ll_append(LinkedList *list,void *data) {
 LinkedListEntry *ll_prepend(LinkedList *list,void *data) {
     LinkedListEntry *retval=NULL;
     if(list!=NULL){
-        if(list->last==NULL) {
-            retval=list->first=list->last=ll_allocEntry(data);
-            retval->owner=list;
-            list->nodeCount++;
+        LL_LOCK(list);
+        if(list->skipFirst!=NULL) {
+            retval = ll_insert(list,data);
+        } else if(list->last==NULL) {
+            if((retval=list->first=list->last=ll_allocEntry(data))!=NULL) {
+                retval->owner=list;
+                list->nodeCount++;
+            }
         } else {
             if(list->sortCompareFunc!=NULL){
                 retval = ll_insert(list,data);
@@ -205,13 +541,17 @@ LinkedListEntry *ll_prepend(LinkedList *list,void *data) {
                 retval = ll_insertBefore(list->first, data);
             }
         }
+        LL_UNLOCK(list);
     }
     return retval;
 }
 
 LinkedListEntry *ll_insertBefore(LinkedListEntry *entry, void *data) {
     LinkedListEntry *newNode=NULL;
+    LinkedList *owner;
     if(entry!=NULL) {
+        owner=entry->owner;
+        LL_LOCK(owner);
         if(entry->owner->sortCompareFunc!=NULL){
             newNode = ll_insert(entry->owner,data);
         }else{
@@ -222,15 +562,18 @@ LinkedListEntry *ll_insertBefore(LinkedListEntry *entry, void *data) {
             
             ll_link(entry->owner,newNode, entry->previous, entry);
         }
+        LL_UNLOCK(owner);
     }
     return newNode;
 }
 
 LinkedListEntry *ll_insertAfter(LinkedListEntry *entry, void *data) {
     LinkedListEntry *newNode=NULL;
-    
+    LinkedList *owner;
     
     if(entry!=NULL) {
+        owner=entry->owner;
+        LL_LOCK(owner);
         if(entry->owner->sortCompareFunc!=NULL){
             newNode = ll_insert(entry->owner,data);
         }else{
@@ -242,6 +585,7 @@ LinkedListEntry *ll_insertAfter(LinkedListEntry *entry, void *data) {
             
             ll_link(entry->owner,newNode,entry,entry->next);
         }
+        LL_UNLOCK(owner);
     }
     
     return newNode;
@@ -253,7 +597,10 @@ LinkedListEntry *ll_insertAfter(LinkedListEntry *entry, void *data) {
 
 void * ll_remove(LinkedListEntry *entry, void *(cleanupFunc)(void *)) {
     void *retval = NULL;
+    LinkedList *owner;
     if(entry!=NULL) {
+        owner=entry->owner;
+        LL_LOCK(owner);
         retval=entry->data;
         if(entry==entry->owner->first) {
             entry->owner->first=entry->next;
@@ -264,7 +611,15 @@ void * ll_remove(LinkedListEntry *entry, void *(cleanupFunc)(void *)) {
         }
         
         ll_unlink(entry);
-        ll_releaseEntry(entry);
+        LL_UNLOCK(owner);
+        if(!entry->isEmbedded) {
+            ll_releaseEntry(entry);
+        }
+        
+        /* an embedded entry may be freed along with its data */
+        if(cleanupFunc!=NULL) {
+            retval=cleanupFunc(retval);
+        }
     }
     
     return retval;
@@ -273,41 +628,77 @@ void * ll_remove(LinkedListEntry *entry, void *(cleanupFunc)(void *)) {
 void ll_destroy(LinkedList *list, void *(cleanupFunc)(void *)) {
     if(list!=NULL) {
         ll_clear(list,cleanupFunc);
+        free(list->skipFirst);
+        list->skipFirst=NULL;
         ll_releaseList(list);
     }
 }
 
+/*
+ * Detaches the whole chain in one pass and hands the list's own entries
+ * back to the pool together, rather than unlinking and releasing them
+ * one at a time.
+ */
 void ll_clear(LinkedList *list, void *(cleanupFunc)(void *)) {
-    LinkedListEntry *toDelete=NULL;
+    LinkedListEntry *released=NULL;
     LinkedListEntry *current;
+    LinkedListEntry *next;
+    long releasedCount=0;
+    void *data;
     if(list!=NULL){
-        current=list->first;
-        while(current!=NULL) {
-            toDelete=current;
-            current=current->next;
+        LL_LOCK(list);
+        for(current=list->first;current!=NULL;current=next) {
+            next=current->next;
+            data=current->data;
+            free(current->skipLinks);
+            if(current->isEmbedded) {
+                current->owner=NULL;
+                current->next=current->previous=NULL;
+                current->skipLinks=NULL;
+                current->skipHeight=0;
+            } else {
+                current->next=released;
+                released=current;
+                releasedCount++;
+            }
+            /* an embedded entry may be freed along with its data */
             if(cleanupFunc!=NULL) {
-                cleanupFunc(toDelete->data);
+                cleanupFunc(data);
             }
-            ll_unlink(toDelete);
-            ll_releaseEntry(toDelete);
         }
+        if(list->skipFirst!=NULL) {
+            memset(list->skipFirst, 0, LL_SKIP_MAX_LANES*sizeof(*list->skipFirst));
+        }
+        list->skipLanes=0;
         list->first=list->last=NULL;
         list->nodeCount=0;
+        LL_UNLOCK(list);
+        if(released!=NULL) {
+            ll_releaseEntries(released, releasedCount);
+        }
     }
 }
 
 void * ll_poll(LinkedList *list) {
     void *retval=NULL;
-    if(list!=NULL && list->first!=NULL) {
-        retval = ll_remove(list->first,NULL);
+    if(list!=NULL) {
+        LL_LOCK(list);
+        if(list->first!=NULL) {
+            retval = ll_remove(list->first,NULL);
+        }
+        LL_UNLOCK(list);
     }
     return retval;
 }
 
 void * ll_pop(LinkedList *list) {
     void *retval=NULL;
-    if(list!=NULL && list->last!=NULL) {
-        retval = ll_remove(list->last,NULL);
+    if(list!=NULL) {
+        LL_LOCK(list);
+        if(list->last!=NULL) {
+            retval = ll_remove(list->last,NULL);
+        }
+        LL_UNLOCK(list);
     }
     return retval;
 }
@@ -315,9 +706,11 @@ void * ll_pop(LinkedList *list) {
 void ll_mapInline(LinkedList *list, void *mapParam, void *(mapFunc)(void *,void *)) {
     LinkedListEntry *entry;
     if(list!=NULL && mapFunc!=NULL) {
+        LL_LOCK(list);
         for(entry=list->first;entry!=NULL;entry=entry->next) {
             entry->data = mapFunc(entry->data,mapParam);
         }
+        LL_UNLOCK(list);
     }
 }
 
@@ -325,6 +718,7 @@ void ll_filterInline(LinkedList *list, void *filterParam, int (filterFunc)(void
     LinkedListEntry tempEntry;
     LinkedListEntry *entry;
     if(list !=NULL && filterFunc!=NULL) {
+        LL_LOCK(list);
         for(entry=list->first;entry!=NULL;entry=entry->next) {
             if(filterFunc(entry->data,filterParam)) {
                 tempEntry.next=entry->next;
@@ -332,6 +726,7 @@ void ll_filterInline(LinkedList *list, void *filterParam, int (filterFunc)(void
                 entry=&tempEntry;
             }
         }
+        LL_UNLOCK(list);
     }
 }
 
@@ -355,12 +750,18 @@ LinkedList * ll_copyAdvanced(LinkedList *list,
             deepCopyFunc=defaultDeepCopyFunc;
         }
         retval=ll_create();
+        LL_LOCK(list);
         retval->sortCompareFunc=list->sortCompareFunc;
+        retval->keyCompareFunc=list->keyCompareFunc;
+        if(list->skipFirst!=NULL) {
+            ll_enableSkipList(retval);
+        }
         for(entry=list->first;entry!=NULL;entry=entry->next) {
             if(filterFunc==NULL || !filterFunc(entry->data,filterParam)) {
                 ll_append(retval,deepCopyFunc(entry->data,deepCopyFuncParam));
             }
         }
+        LL_UNLOCK(list);
     }
     
     return retval;
@@ -373,65 +774,744 @@ LinkedList *ll_searchFindAll(LinkedList *list, void * searchParam, int (sortComp
     int sfRes=0;
     if(list!=NULL && sortCompareFunc!=NULL) {
         retval = ll_create();
+        LL_LOCK(list);
+        LL_STAT(searches, 1);
         for(entry=list->first;entry!=NULL && sfRes!=-1;entry=entry->next) {
+            LL_STAT(searchVisits, 1);
             if((sfRes=sortCompareFunc(entry->data,searchParam))) {
                 ll_append(retval, entry);
             }
         }
+        LL_UNLOCK(list);
+    }
+    
+    return retval;
+}
+
+/*
+ * Whether b's data sorts strictly before a, asked the way a skip list
+ * asks: context[LL_SORT_CONTEXT_CURRENT] is a and the other two slots
+ * are NULL, since the links around a are in flux during a sort.
+ */
+static int ll_entrySortsBefore(LinkedList *list, LinkedListEntry *b, LinkedListEntry *a) {
+    LinkedListEntry *context[3];
+    context[LL_SORT_CONTEXT_PREVIOUS]=NULL;
+    context[LL_SORT_CONTEXT_CURRENT]=a;
+    context[LL_SORT_CONTEXT_NEXT]=NULL;
+    LL_STAT(compareCalls, 1);
+    return list->sortCompareFunc(context, b->data)==LL_SORT_INSERT_BEFORE_CURRENT;
+}
+
+/*
+ * Bottom-up merge sort over the next links of the chain starting at
+ * head: runs of 1, 2, 4, ... entries are merged pairwise until a single
+ * pass makes one merge. Ties take the earlier run's entry, so the sort
+ * is stable. Only next is maintained; returns the new head.
+ *
+ * A chain already in order, as batches built in address order usually
+ * are, is recognised in one walk and returned as it is.
+ */
+static LinkedListEntry *ll_sortChain(LinkedList *list, LinkedListEntry *head) {
+    LinkedListEntry *tail;
+    LinkedListEntry *p;
+    LinkedListEntry *q;
+    LinkedListEntry *taken;
+    long runLength;
+    long pSize;
+    long qSize;
+    long merges;
+    
+    for(p=head;p!=NULL && p->next!=NULL && !ll_entrySortsBefore(list, p->next, p);p=p->next) {
+        //Empty loop
+    }
+    if(p==NULL || p->next==NULL) {
+        return head;
+    }
+    
+    for(runLength=1;;runLength*=2) {
+        p=head;
+        head=tail=NULL;
+        merges=0;
+        while(p!=NULL) {
+            merges++;
+            for(q=p,pSize=0;pSize<runLength && q!=NULL;pSize++) {
+                q=q->next;
+            }
+            qSize=runLength;
+            
+            while(pSize>0 || (qSize>0 && q!=NULL)) {
+                if(pSize==0) {
+                    taken=q;
+                    q=q->next;
+                    qSize--;
+                } else if(qSize==0 || q==NULL || !ll_entrySortsBefore(list, q, p)) {
+                    taken=p;
+                    p=p->next;
+                    pSize--;
+                } else {
+                    taken=q;
+                    q=q->next;
+                    qSize--;
+                }
+                
+                if(tail!=NULL) {
+                    tail->next=taken;
+                } else {
+                    head=taken;
+                }
+                tail=taken;
+            }
+            p=q;
+        }
+        tail->next=NULL;
+        
+        if(merges<=1) {
+            break;
+        }
+    }
+    return head;
+}
+
+/*
+ * Sorts the whole list in place, then rebuilds previous, last and any
+ * express lanes in one final walk.
+ */
+static void ll_mergeSort(LinkedList *list) {
+    LinkedListEntry *previous;
+    LinkedListEntry *entry;
+    
+    if(list->nodeCount<2) {
+        return;
+    }
+    
+    list->first=ll_sortChain(list, list->first);
+    for(previous=NULL,entry=list->first;entry!=NULL;previous=entry,entry=entry->next) {
+        entry->previous=previous;
     }
+    list->last=previous;
     
+    if(list->skipFirst!=NULL) {
+        ll_relinkSkipLanes(list);
+    }
+}
+
+/*
+ * Adapts a two-argument key comparator to the context comparator the
+ * rest of the list works with. Equal keys place the new data after the
+ * existing ones.
+ */
+static int ll_keySortComparator(LinkedListEntry *context[], void *newData) {
+    int retval=LL_SORT_DO_NOT_INSERT_YET;
+    LinkedListEntry *current=context[LL_SORT_CONTEXT_CURRENT];
+    LinkedListEntry *next=context[LL_SORT_CONTEXT_NEXT];
+    int (*keyCompareFunc)(void *, void *)=current->owner->keyCompareFunc;
+    
+    if(keyCompareFunc(newData, current->data)<0) {
+        retval = LL_SORT_INSERT_BEFORE_CURRENT;
+    } else if(next==NULL || keyCompareFunc(newData, next->data)<0) {
+        retval = LL_SORT_INSERT_AFTER_CURRENT;
+    }
     return retval;
 }
 
+static void ll_setSortOrder(LinkedList *list,
+                            int (sortComparator)(LinkedListEntry *[], void *),
+                            int (keyCompareFunc)(void *, void *)) {
+    list->sortCompareFunc=sortComparator;
+    list->keyCompareFunc=keyCompareFunc;
+    if(sortComparator!=NULL) {
+        ll_mergeSort(list);
+    } else if(list->skipFirst!=NULL) {
+        /* an unsorted list cannot keep a skip list */
+        ll_disableSkipList(list);
+    }
+}
+
 int ll_assignSortFunction(LinkedList *list, int sortComparator(LinkedListEntry *[], void *)) {
     int retval = LL_SUCCESS;
     if(list!=NULL) {
-        if(list->nodeCount>1) {
-            retval = LL_RESORT_NOT_YET_SUPPORTED;
-        }
-        else {
-            list->sortCompareFunc=sortComparator;
-        }
+        LL_LOCK(list);
+        ll_setSortOrder(list, sortComparator, NULL);
+        LL_UNLOCK(list);
     } else {
         retval = LL_NULL_LIST;
     }
     return retval;
 }
-LinkedListEntry *ll_insert(LinkedList *list, void *data) {
+
+int ll_assignKeySortFunction(LinkedList *list, int (keyCompareFunc)(void *, void *)) {
+    int retval = LL_SUCCESS;
+    if(list!=NULL) {
+        LL_LOCK(list);
+        ll_setSortOrder(list, (keyCompareFunc==NULL ? NULL : ll_keySortComparator), keyCompareFunc);
+        LL_UNLOCK(list);
+    } else {
+        retval = LL_NULL_LIST;
+    }
+    return retval;
+}
+
+/*
+ * Links newEntry into its sorted position. Returns NULL, leaving
+ * newEntry unlinked, if sortCompareFunc never agrees to place it.
+ */
+static LinkedListEntry *ll_placeSorted(LinkedList *list, LinkedListEntry *newEntry) {
     LinkedListEntry *retval=NULL;
     LinkedListEntry *current;
     LinkedListEntry *context[3];
     int sortCompareReturn = LL_SORT_DO_NOT_INSERT_YET;
+    
+    LL_STAT(inserts, 1);
+    if(list->skipFirst!=NULL) {
+        retval = ll_skipPlace(list,newEntry);
+    } else if(list->first==NULL) {
+        ll_link(list,newEntry,NULL,NULL);
+        retval=list->first=list->last=newEntry;
+    }
+    
+    for(current=list->first;current!=NULL && retval == NULL;current=current->next ){
+        context[0]=current->previous;
+        context[1]=current;
+        context[2]=current->next;
+        LL_STAT(insertVisits, 1);
+        LL_STAT(compareCalls, 1);
+        sortCompareReturn = list->sortCompareFunc(context, newEntry->data);
+        if(sortCompareReturn!=LL_SORT_DO_NOT_INSERT_YET){
+            retval = newEntry;
+            
+            if(sortCompareReturn == LL_SORT_INSERT_BEFORE_CURRENT) {
+                if(current==list->first){
+                    list->first=retval;
+                }
+                
+                ll_link(list,retval,current->previous,current);
+                
+            } else { /*insert after*/
+                if(current == list->last) {
+                    list->last=retval;
+                }
+                ll_link(list,retval,current,current->next);
+            }
+        }
+    }
+    return retval;
+}
+
+LinkedListEntry *ll_insert(LinkedList *list, void *data) {
+    LinkedListEntry *retval=NULL;
+    LinkedListEntry *newEntry;
+    LL_LOCK(list);
     if(list->sortCompareFunc!=NULL) {
-        if(list->first==NULL) {
-            retval = ll_append(list,data);
+        if((newEntry=ll_allocEntry(data))!=NULL &&
+           (retval=ll_placeSorted(list,newEntry))==NULL) {
+            ll_releaseEntry(newEntry);
         }
+    } else {
+        retval = ll_prepend(list, data);
+    }
+    LL_UNLOCK(list);
+    return retval;
+}
+
+LinkedListEntry *ll_appendEntry(LinkedList *list, LinkedListEntry *entry, void *data) {
+    LinkedListEntry *retval=NULL;
+    if(list!=NULL && entry!=NULL && entry->owner==NULL) {
+        LL_LOCK(list);
+        entry->data=data;
+        entry->isEmbedded=1;
+        entry->next=entry->previous=NULL;
+        entry->skipLinks=NULL;
+        entry->skipHeight=0;
         
-        for(current=list->first;current!=NULL && retval == NULL;current=current->next ){
-            context[0]=current->previous;
-            context[1]=current;
-            context[2]=current->next;
-            sortCompareReturn = list->sortCompareFunc(context, data);
-            if(sortCompareReturn!=LL_SORT_DO_NOT_INSERT_YET){
-                retval = ll_allocEntry(data);
-                
-                if(sortCompareReturn == LL_SORT_INSERT_BEFORE_CURRENT) {
-                    if(current==list->first){
-                        list->first=retval;
-                    }
-                    
-                    ll_link(list,retval,current->previous,current);
-                    
-                } else { /*insert after*/
-                    if(current == list->last) {
-                        list->last=retval;
+        if(list->sortCompareFunc!=NULL) {
+            retval = ll_placeSorted(list,entry);
+        } else if(ll_link(list,entry,list->last,NULL)==LL_SUCCESS) {
+            if(list->first==NULL) {
+                list->first=entry;
+            }
+            retval=list->last=entry;
+        }
+        LL_UNLOCK(list);
+    }
+    return retval;
+}
+
+int ll_appendArray(LinkedList *list, void *data[], long count) {
+    int retval=LL_SUCCESS;
+    LinkedListEntry *chain;
+    LinkedListEntry *entry;
+    LinkedListEntry *next;
+    LinkedListEntry *tail;
+    long i;
+    
+    if(list==NULL) {
+        retval = LL_NULL_LIST;
+    } else if(count>0) {
+        LL_LOCK(list);
+        if((chain=ll_allocEntries(count))==NULL) {
+            retval = LL_ERR_ALLOCATION_FAILED;
+        } else if(list->sortCompareFunc!=NULL) {
+            for(i=0,entry=chain;entry!=NULL;i++,entry=next) {
+                next=entry->next;
+                entry->next=NULL;
+                entry->data=data[i];
+                if(ll_placeSorted(list,entry)==NULL) {
+                    ll_releaseEntry(entry);
+                }
+            }
+        } else {
+            /* the chain is already linked through next; fill in the rest */
+            tail=list->last;
+            for(i=0,entry=chain;entry!=NULL;i++,entry=entry->next) {
+                entry->data=data[i];
+                entry->owner=list;
+                entry->previous=tail;
+                tail=entry;
+            }
+            if(list->last!=NULL) {
+                list->last->next=chain;
+            } else {
+                list->first=chain;
+            }
+            list->last=tail;
+            list->nodeCount+=count;
+        }
+        LL_UNLOCK(list);
+    }
+    return retval;
+}
+
+/*
+ * Sorts count unlinked entries chained through next and merges them
+ * into the sorted list in a single walk from list->first: every new
+ * entry goes before the first existing entry it sorts before, so equal
+ * data keeps insertion order. Under a skip list the new entries get
+ * towers and the lanes are relinked once at the end.
+ */
+static void ll_mergeBatch(LinkedList *list, LinkedListEntry *chain, long count) {
+    LinkedListEntry *current=list->first;
+    LinkedListEntry *previous;
+    LinkedListEntry *entry;
+    int height;
+    
+    LL_STAT(inserts, count);
+    for(entry=chain;entry!=NULL;entry=entry->next) {
+        entry->owner=list;
+        if(list->skipFirst!=NULL && (height=ll_randomSkipHeight(list))>0 &&
+           (entry->skipLinks=malloc(height*sizeof(*entry->skipLinks)))!=NULL) {
+            entry->skipHeight=height;
+        }
+    }
+    
+    chain=ll_sortChain(list, chain);
+    while(chain!=NULL) {
+        entry=chain;
+        chain=chain->next;
+        while(current!=NULL && !ll_entrySortsBefore(list, entry, current)) {
+            LL_STAT(insertVisits, 1);
+            current=current->next;
+        }
+        
+        previous=(current==NULL ? list->last : current->previous);
+        entry->previous=previous;
+        entry->next=current;
+        if(previous!=NULL) {
+            previous->next=entry;
+        } else {
+            list->first=entry;
+        }
+        if(current!=NULL) {
+            current->previous=entry;
+        } else {
+            list->last=entry;
+        }
+    }
+    list->nodeCount+=count;
+    
+    if(list->skipFirst!=NULL) {
+        ll_relinkSkipLanes(list);
+    }
+}
+
+int ll_insertBatch(LinkedList *list, void *data[], long count) {
+    int retval=LL_SUCCESS;
+    LinkedListEntry *chain;
+    LinkedListEntry *entry;
+    long i;
+    
+    if(list==NULL) {
+        retval = LL_NULL_LIST;
+    } else if(list->sortCompareFunc==NULL) {
+        retval = LL_ERR_NOT_SORTED;
+    } else if(count>0) {
+        LL_LOCK(list);
+        if((chain=ll_allocEntries(count))==NULL) {
+            retval = LL_ERR_ALLOCATION_FAILED;
+        } else {
+            for(i=0,entry=chain;entry!=NULL;i++,entry=entry->next) {
+                entry->data=data[i];
+            }
+            ll_mergeBatch(list, chain, count);
+        }
+        LL_UNLOCK(list);
+    }
+    return retval;
+}
+
+int ll_insertEntryBatch(LinkedList *list, LinkedListEntry *entries[], void *data[], long count) {
+    int retval=LL_SUCCESS;
+    LinkedListEntry *chain=NULL;
+    long i;
+    
+    if(list==NULL) {
+        retval = LL_NULL_LIST;
+    } else if(list->sortCompareFunc==NULL) {
+        retval = LL_ERR_NOT_SORTED;
+    } else {
+        for(i=0;i<count && retval==LL_SUCCESS;i++) {
+            if(entries[i]==NULL) {
+                retval = LL_ERR_BAD_ENTRY;
+            } else if(entries[i]->owner!=NULL) {
+                retval = LL_ERR_ENTRY_ALREADY_OWNED;
+            }
+        }
+        
+        if(retval==LL_SUCCESS && count>0) {
+            LL_LOCK(list);
+            for(i=count-1;i>=0;i--) {
+                entries[i]->data=data[i];
+                entries[i]->isEmbedded=1;
+                entries[i]->previous=NULL;
+                entries[i]->skipLinks=NULL;
+                entries[i]->skipHeight=0;
+                entries[i]->next=chain;
+                chain=entries[i];
+            }
+            ll_mergeBatch(list, chain, count);
+            LL_UNLOCK(list);
+        }
+    }
+    return retval;
+}
+
+#ifdef LL_THREAD_SAFE
+/*
+ * Two lists are always locked in address order so that concurrent
+ * splices in opposite directions cannot deadlock.
+ */
+static void ll_lockPair(LinkedList *a, LinkedList *b) {
+    if(a>b) {
+        LL_LOCK(b);
+        LL_LOCK(a);
+    } else {
+        LL_LOCK(a);
+        LL_LOCK(b);
+    }
+}
+#else
+#define ll_lockPair(a, b) ((void)(a), (void)(b))
+#endif
+
+int ll_spliceRange(LinkedList *destination, LinkedListEntry *before, LinkedListEntry *first, LinkedListEntry *last) {
+    int retval=LL_SUCCESS;
+    LinkedList *source;
+    LinkedListEntry *entry;
+    LinkedListEntry *previous;
+    long count=0;
+    
+    if(destination==NULL) {
+        retval = LL_NULL_LIST;
+    } else if(first==NULL || last==NULL || first->owner==NULL) {
+        retval = LL_ERR_BAD_ENTRY;
+    } else if(last->owner!=first->owner || (before!=NULL && before->owner!=destination)) {
+        retval = LL_ERR_DIFFERENT_LISTS;
+    } else if(destination->sortCompareFunc!=NULL) {
+        retval = LL_ERR_SORTED_LIST;
+    } else {
+        source=first->owner;
+        ll_lockPair(source, destination);
+        
+        /* last must follow first, and before must not be inside the run */
+        for(entry=first;entry!=NULL;entry=entry->next) {
+            if(entry==before) {
+                entry=NULL;
+                break;
+            }
+            count++;
+            if(entry==last) {
+                break;
+            }
+        }
+        
+        if(entry==NULL) {
+            retval = LL_ERR_BAD_ENTRY;
+        } else {
+            if(first->previous!=NULL) {
+                first->previous->next=last->next;
+            } else {
+                source->first=last->next;
+            }
+            if(last->next!=NULL) {
+                last->next->previous=first->previous;
+            } else {
+                source->last=first->previous;
+            }
+            
+            if(source!=destination) {
+                for(entry=first;entry!=last->next;entry=entry->next) {
+                    if(entry->skipLinks!=NULL) {
+                        ll_unlinkSkipTower(entry);
                     }
-                    ll_link(list,retval,current,current->next);
+                    entry->owner=destination;
                 }
+                source->nodeCount-=count;
+                destination->nodeCount+=count;
+            }
+            
+            previous=(before==NULL ? destination->last : before->previous);
+            first->previous=previous;
+            last->next=before;
+            if(previous!=NULL) {
+                previous->next=first;
+            } else {
+                destination->first=first;
+            }
+            if(before!=NULL) {
+                before->previous=last;
+            } else {
+                destination->last=last;
             }
         }
+        LL_UNLOCK(destination);
+        LL_UNLOCK(source);
+    }
+    return retval;
+}
+
+int ll_spliceList(LinkedList *destination, LinkedListEntry *before, LinkedList *source) {
+    int retval=LL_SUCCESS;
+    
+    if(destination==NULL || source==NULL) {
+        retval = LL_NULL_LIST;
     } else {
-        retval = ll_prepend(list, data);
+        LL_LOCK(source);
+        if(source->first!=NULL) {
+            retval = ll_spliceRange(destination, before, source->first, source->last);
+        }
+        LL_UNLOCK(source);
+    }
+    return retval;
+}
+
+/*
+ * xorshift; the promotion pattern only has to look random to the data,
+ * not be unpredictable.
+ */
+static int ll_randomSkipHeight(LinkedList *list) {
+    int height=0;
+    unsigned int x=list->skipSeed;
+    
+    if(x==0) {
+        x=0x9E3779B9u;
+    }
+    do {
+        x^=x<<13;
+        x^=x>>17;
+        x^=x<<5;
+    } while((x & 3)==0 && ++height<LL_SKIP_MAX_LANES);
+    list->skipSeed=x;
+    
+    return height;
+}
+
+static int ll_sortsBefore(LinkedList *list, void *data, LinkedListEntry *entry) {
+    LinkedListEntry *context[3];
+    context[LL_SORT_CONTEXT_PREVIOUS]=entry->previous;
+    context[LL_SORT_CONTEXT_CURRENT]=entry;
+    context[LL_SORT_CONTEXT_NEXT]=NULL;
+    LL_STAT(insertVisits, 1);
+    LL_STAT(compareCalls, 1);
+    return list->sortCompareFunc(context, data)==LL_SORT_INSERT_BEFORE_CURRENT;
+}
+
+/*
+ * Gives entry a tower of height lanes, linking each lane after the
+ * matching entry of predecessors (NULL meaning the head of the lane).
+ */
+static int ll_linkSkipTower(LinkedList *list, LinkedListEntry *entry, LinkedListEntry *predecessors[], int height) {
+    int retval=LL_SUCCESS;
+    int lane;
+    LinkedListEntry *next;
+    
+    if(height>0) {
+        entry->skipLinks=malloc(height*sizeof(*entry->skipLinks));
+        if(entry->skipLinks==NULL) {
+            retval=LL_ERR_ALLOCATION_FAILED;
+            height=0;
+        }
+    }
+    
+    entry->skipHeight=height;
+    for(lane=0;lane<height;lane++) {
+        next=(predecessors[lane]==NULL ? list->skipFirst[lane] : predecessors[lane]->skipLinks[lane].next);
+        entry->skipLinks[lane].next=next;
+        entry->skipLinks[lane].previous=predecessors[lane];
+        if(next!=NULL) {
+            next->skipLinks[lane].previous=entry;
+        }
+        if(predecessors[lane]==NULL) {
+            list->skipFirst[lane]=entry;
+        } else {
+            predecessors[lane]->skipLinks[lane].next=entry;
+        }
+    }
+    
+    if(height>list->skipLanes) {
+        list->skipLanes=height;
+    }
+    return retval;
+}
+
+static LinkedListEntry *ll_skipPlace(LinkedList *list, LinkedListEntry *newEntry) {
+    LinkedListEntry *predecessors[LL_SKIP_MAX_LANES];
+    LinkedListEntry *current=NULL;
+    LinkedListEntry *next;
+    void *data=newEntry->data;
+    int lane;
+    
+    for(lane=list->skipLanes;lane<LL_SKIP_MAX_LANES;lane++) {
+        predecessors[lane]=NULL;
+    }
+    
+    for(lane=list->skipLanes-1;lane>=0;lane--) {
+        for(next=(current==NULL ? list->skipFirst[lane] : current->skipLinks[lane].next);
+            next!=NULL && !ll_sortsBefore(list, data, next);
+            next=current->skipLinks[lane].next) {
+            current=next;
+        }
+        predecessors[lane]=current;
+    }
+    
+    for(next=(current==NULL ? list->first : current->next);
+        next!=NULL && !ll_sortsBefore(list, data, next);
+        next=current->next) {
+        current=next;
+    }
+    
+    if(current==NULL) {
+        ll_link(list, newEntry, NULL, list->first);
+        list->first=newEntry;
+    } else {
+        ll_link(list, newEntry, current, current->next);
+    }
+    
+    if(current==list->last) {
+        list->last=newEntry;
+    }
+    ll_linkSkipTower(list, newEntry, predecessors, ll_randomSkipHeight(list));
+    return newEntry;
+}
+
+/*
+ * Threads the existing towers through the lanes again in the list's
+ * current order, after the order has been changed underneath them.
+ */
+static void ll_relinkSkipLanes(LinkedList *list) {
+    LinkedListEntry *tails[LL_SKIP_MAX_LANES]={0};
+    LinkedListEntry *entry;
+    int lane;
+    
+    memset(list->skipFirst, 0, LL_SKIP_MAX_LANES*sizeof(*list->skipFirst));
+    list->skipLanes=0;
+    for(entry=list->first;entry!=NULL;entry=entry->next) {
+        for(lane=0;lane<entry->skipHeight;lane++) {
+            entry->skipLinks[lane].previous=tails[lane];
+            entry->skipLinks[lane].next=NULL;
+            if(tails[lane]==NULL) {
+                list->skipFirst[lane]=entry;
+            } else {
+                tails[lane]->skipLinks[lane].next=entry;
+            }
+            tails[lane]=entry;
+        }
+        if(entry->skipHeight>list->skipLanes) {
+            list->skipLanes=entry->skipHeight;
+        }
+    }
+}
+
+static void ll_disableSkipList(LinkedList *list) {
+    LinkedListEntry *entry;
+    
+    for(entry=list->first;entry!=NULL;entry=entry->next) {
+        free(entry->skipLinks);
+        entry->skipLinks=NULL;
+        entry->skipHeight=0;
+    }
+    free(list->skipFirst);
+    list->skipFirst=NULL;
+    list->skipLanes=0;
+}
+
+int ll_enableSkipList(LinkedList *list) {
+    int retval=LL_SUCCESS;
+    int lane;
+    LinkedListEntry *tails[LL_SKIP_MAX_LANES]={0};
+    LinkedListEntry *entry;
+    
+    if(list==NULL) {
+        retval = LL_NULL_LIST;
+    } else if(list->sortCompareFunc==NULL) {
+        retval = LL_ERR_NOT_SORTED;
+    } else {
+        LL_LOCK(list);
+        if(list->skipFirst==NULL) {
+            list->skipFirst=calloc(LL_SKIP_MAX_LANES, sizeof(*list->skipFirst));
+            list->skipLanes=0;
+            if(list->skipFirst==NULL) {
+                retval = LL_ERR_ALLOCATION_FAILED;
+            }
+            
+            for(entry=list->first;entry!=NULL && retval==LL_SUCCESS;entry=entry->next) {
+                retval=ll_linkSkipTower(list, entry, tails, ll_randomSkipHeight(list));
+                for(lane=0;lane<entry->skipHeight;lane++) {
+                    tails[lane]=entry;
+                }
+            }
+        }
+        LL_UNLOCK(list);
+    }
+    return retval;
+}
+
+LinkedListEntry *ll_searchSorted(LinkedList *list, void *key, int (keyCompareFunc)(void *, void *)) {
+    LinkedListEntry *retval=NULL;
+    LinkedListEntry *current=NULL;
+    LinkedListEntry *next;
+    int lane;
+    
+    if(list!=NULL && keyCompareFunc!=NULL) {
+        LL_LOCK(list);
+        LL_STAT(searches, 1);
+        for(lane=(list->skipFirst==NULL ? -1 : list->skipLanes-1);lane>=0;lane--) {
+            for(next=(current==NULL ? list->skipFirst[lane] : current->skipLinks[lane].next);
+                next!=NULL && keyCompareFunc(next->data, key)<0;
+                next=current->skipLinks[lane].next) {
+                LL_STAT(searchVisits, 1);
+                current=next;
+            }
+        }
+        
+        for(next=(current==NULL ? list->first : current->next);
+            next!=NULL && keyCompareFunc(next->data, key)<0;
+            next=next->next) {
+            LL_STAT(searchVisits, 1);
+        }
+        
+        if(next!=NULL && keyCompareFunc(next->data, key)==0) {
+            retval=next;
+        }
+        LL_UNLOCK(list);
     }
     return retval;
 }
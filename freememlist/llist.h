@@ -9,10 +9,62 @@
 #ifndef llist_llist_h
 #define llist_llist_h
 
-#ifdef LL_STATIC_ALLOCATION
+#include <stddef.h>
+#ifdef LL_THREAD_SAFE
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Entries and lists are carved from growable slab pools (see slab.h)
+ * unless LL_SYSTEM_ALLOCATION is defined, in which case every entry and
+ * list is a separate calloc. initializeFreeList prepares the pools; it
+ * is called on first use, so calling it explicitly is optional.
+ * ll_trimPools hands cached empty slabs back to the system.
+ *
+ * With LL_THREAD_SAFE each thread keeps a private cache of entries in
+ * front of the shared pool and only takes the pool lock to move a batch
+ * of LL_CACHE_BATCH entries in or out. ll_trimPools also returns the
+ * calling thread's cache.
+ */
+#ifndef LL_SYSTEM_ALLOCATION
 int initializeFreeList();
+void ll_trimPools();
 #else
 #define initializeFreeList() LL_SUCCESS
+#define ll_trimPools()
+#endif
+
+/*
+ * Building with LL_STATS keeps process-wide counters of list work:
+ * searches (ll_search, ll_searchFindAll, ll_searchSorted) and sorted
+ * inserts with the entries each one visited, calls made to a list's
+ * sortCompareFunc, entries allocated and released, and how often an
+ * allocation was served by the pool (the thread's cache under
+ * LL_THREAD_SAFE) without growing it. ll_getStats also reports
+ * liveEntries, the entries taken from the shared pool and not yet
+ * returned to it, including those parked in thread caches. Without LL_STATS the counting
+ * compiles away entirely.
+ */
+#ifdef LL_STATS
+typedef struct LinkedListStats {
+    long searches;
+    long searchVisits;
+    long inserts;
+    long insertVisits;
+    long compareCalls;
+    long entryAllocs;
+    long entryReleases;
+    long poolHits;
+    long poolMisses;
+    long liveEntries;
+} LinkedListStats;
+
+void ll_getStats(LinkedListStats *stats);
+void ll_resetStats();
 #endif
 
 #define LL_SORT_INSERT_BEFORE_CURRENT 0
@@ -31,28 +83,88 @@ int initializeFreeList();
 #define LL_NULL_LIST 4
 #define LL_ERR_FREELISTS_INIT_FAILED 5
 #define LL_ERR_ENTRY_NOT_OWNED 6
+#define LL_ERR_NOT_SORTED 7
+#define LL_ERR_ALLOCATION_FAILED 8
+#define LL_ERR_SORTED_LIST 9
 #define LL_RESORT_NOT_YET_SUPPORTED 999
 
 
+/*
+ * Number of express lanes a skip list may build above the ordinary
+ * next/previous chain. With a 1 in 4 promotion rate this comfortably
+ * covers lists of a few billion entries.
+ */
+#define LL_SKIP_MAX_LANES 15
+
+/*
+ * Recovers the structure an embedded LinkedListEntry lives in, e.g.
+ * LL_CONTAINER_OF(entry, pageDef, link). See ll_appendEntry.
+ */
+#define LL_CONTAINER_OF(entry, type, member) \
+    ((type *)((char *)(entry) - offsetof(type, member)))
+
 typedef struct LinkedListEntry LinkedListEntry;
 typedef struct LinkedList LinkedList;
+typedef struct LinkedListSkipLink LinkedListSkipLink;
+
+struct LinkedListSkipLink {
+    LinkedListEntry *next;
+    LinkedListEntry *previous;
+};
 
+/*
+ * skipLinks holds one link per express lane the entry was promoted to
+ * and is only allocated for entries of lists with a skip list enabled.
+ * isEmbedded marks entries supplied through ll_appendEntry, which the
+ * list never allocates or releases.
+ */
 struct LinkedListEntry {
     LinkedListEntry *next;
     LinkedListEntry *previous;
     LinkedList *owner;
     void *data;
+    LinkedListSkipLink *skipLinks;
+    int skipHeight;
+    int isEmbedded;
 };
 
+/*
+ * keyCompareFunc is set only by ll_assignKeySortFunction, in which case
+ * sortCompareFunc is an adapter calling it. skipFirst is NULL unless
+ * ll_enableSkipList has been called; it then holds the first entry of
+ * each express lane.
+ *
+ * When built with LL_THREAD_SAFE every list carries its own recursive
+ * lock, taken by each public function for the duration of the call, so
+ * lists must be obtained from ll_create. Functions that take an entry
+ * lock the entry's owner; the caller must still make sure that an entry
+ * is not removed by one thread while another is using it. Callbacks
+ * run with the lock held and may call back into the same list.
+ */
 struct LinkedList {
     LinkedListEntry *first;
     LinkedListEntry *last;
     long nodeCount;
     int (*sortCompareFunc)(LinkedListEntry *[], void *);
+    int (*keyCompareFunc)(void *, void *);
+    LinkedListEntry **skipFirst;
+    int skipLanes;
+    unsigned int skipSeed;
+#ifdef LL_THREAD_SAFE
+    pthread_mutex_t lock;
+#endif
 };
 
 LinkedList *ll_create();
 
+/*
+ * Hands out a zeroed, unowned entry holding data from the same pool the
+ * lists use, and takes one back. These exist for containers built on
+ * top of LinkedListEntry (see llqueue.h); list users never need them.
+ */
+LinkedListEntry *ll_allocEntry(void *data);
+void ll_releaseEntry(LinkedListEntry *entry);
+
 /*
  * Calls ll_clear and then frees the list.
  *
@@ -86,19 +198,131 @@ LinkedListEntry *ll_search(LinkedList *list, void * searchParam, int (searchFunc
 LinkedList *ll_searchFindAll(LinkedList *list, void * searchParam, int (searchFunc)(void *,void *));
 
 LinkedListEntry *ll_append(LinkedList *list,void *data);
+
+/*
+ * Intrusive variant of ll_append: links an entry the caller embedded in
+ * its own structure instead of allocating one, honouring the list's
+ * sort function like ll_append does. data is stored in
+ * LinkedListEntry.data as usual and is normally the containing
+ * structure itself. entry must be zeroed or have been removed from its
+ * previous list; NULL is returned if it is still owned by a list.
+ *
+ * ll_remove, ll_clear and friends unlink embedded entries without
+ * releasing them, and only then call cleanupFunc, so cleanupFunc may
+ * free the structure that holds the entry.
+ */
+LinkedListEntry *ll_appendEntry(LinkedList *list, LinkedListEntry *entry, void *data);
+
+/*
+ * Appends count data pointers in one call, taking all count entries
+ * from the pool at once. A sorted list places each one as ll_insert
+ * would. Returns LL_ERR_ALLOCATION_FAILED, adding nothing, if the
+ * entries cannot all be allocated.
+ */
+int ll_appendArray(LinkedList *list, void *data[], long count);
+
+/*
+ * Moves the run of entries from first through last, which must belong
+ * to the same list with last at or after first, into destination
+ * immediately before the entry before (at the tail if before is NULL).
+ * The entries themselves move, so pointers to them stay valid, and no
+ * entry is allocated or released. The run is relinked in constant time
+ * but is walked once to update each entry's owner and the two lists'
+ * nodeCounts.
+ *
+ * destination may be the run's own list, as long as before lies outside
+ * the run. destination must not have a sort function
+ * (LL_ERR_SORTED_LIST); entries leaving a skip list lose their express
+ * lanes. Returns LL_ERR_BAD_ENTRY if last does not follow first or
+ * before lies inside the run.
+ */
+int ll_spliceRange(LinkedList *destination, LinkedListEntry *before, LinkedListEntry *first, LinkedListEntry *last);
+
+/*
+ * Moves every entry of source into destination before the entry before
+ * (at the tail if NULL), leaving source empty. See ll_spliceRange.
+ */
+int ll_spliceList(LinkedList *destination, LinkedListEntry *before, LinkedList *source);
 LinkedListEntry *ll_prepend(LinkedList *list,void *data);
 //LinkedListEntry *ll_insert(LinkedListEntry *entry, int insertMode, void *data);
 LinkedListEntry *ll_insertBefore(LinkedListEntry *entry, void *data);
 LinkedListEntry *ll_insertAfter(LinkedListEntry *entry, void *data);
 
+/*
+ * Gives list a sort order, or with NULL makes it unsorted again (which
+ * also drops any skip list). A populated list is re-sorted in place by
+ * a stable O(n log n) merge sort over the existing links, which
+ * allocates nothing; entries keep their identity. While sorting,
+ * sortComparator is only asked whether the data sorts before
+ * context[LL_SORT_CONTEXT_CURRENT], the other two slots being NULL, as
+ * with a skip list.
+ */
 int ll_assignSortFunction(LinkedList *list, int sortComparator(LinkedListEntry *[],void *));
+
+/*
+ * As ll_assignSortFunction, but with a plain comparator: keyCompareFunc
+ * is passed two LinkedListEntry.data pointers and returns a negative
+ * value, 0 or a positive value as the first sorts before, with or after
+ * the second. Data that compares equal keeps its insertion order.
+ */
+int ll_assignKeySortFunction(LinkedList *list, int (keyCompareFunc)(void *, void *));
 LinkedListEntry *ll_insert(LinkedList *list, void *data);
 
+/*
+ * Inserts count data pointers into a sorted list in one go: the batch is
+ * merge sorted by the list's sort function and then merged into the
+ * list in a single walk, so k inserts into a list of n entries cost
+ * O(n + k log k) rather than O(n k). The entries are allocated
+ * together, as by ll_appendArray. Data that compares equal to entries
+ * already present goes after them. Returns LL_ERR_NOT_SORTED if no
+ * sort function has been assigned.
+ *
+ * The sort function is asked the same question as by a skip list (see
+ * ll_enableSkipList).
+ */
+int ll_insertBatch(LinkedList *list, void *data[], long count);
+
+/*
+ * Intrusive variant of ll_insertBatch: links entries[i], holding
+ * data[i], for every i as ll_appendEntry would. Every entry must be
+ * unowned; if any is not, nothing is inserted and
+ * LL_ERR_ENTRY_ALREADY_OWNED is returned.
+ */
+int ll_insertEntryBatch(LinkedList *list, LinkedListEntry *entries[], void *data[], long count);
+
+/*
+ * Layers a skip list over a sorted list so ll_insert and
+ * ll_searchSorted take expected O(log n) rather than walking from
+ * list->first. The first/last/next/previous chain is kept exactly as
+ * before, so every other function works unchanged. May be called on a
+ * populated list. Returns LL_ERR_NOT_SORTED if no sort function has
+ * been assigned.
+ *
+ * While the skip list is enabled sortCompareFunc is only asked whether
+ * the new data sorts before context[LL_SORT_CONTEXT_CURRENT];
+ * context[LL_SORT_CONTEXT_NEXT] is always NULL and any return other
+ * than LL_SORT_INSERT_BEFORE_CURRENT places the data after it. Entries
+ * that compare equal keep their insertion order.
+ */
+int ll_enableSkipList(LinkedList *list);
+
+/*
+ * Finds the first entry whose data matches key in a list that is
+ * ordered consistently with keyCompareFunc. keyCompareFunc is passed
+ * LinkedListEntry.data and key and returns a negative value if the data
+ * sorts before key, 0 on a match and a positive value if it sorts after
+ * key. Uses the skip list when one is enabled and otherwise stops
+ * walking at the first entry that sorts after key. Returns NULL if
+ * there is no match.
+ */
+LinkedListEntry *ll_searchSorted(LinkedList *list, void *key, int (keyCompareFunc)(void *, void *));
+
 
 /*
  * cleanupFunc is optional; if supplied it will be called against the
- * LinkedListEntry.data member prior to entry deallocation. The return
- * value of cleanupFunc will be returned by ll_remove if cleanupFunc
+ * LinkedListEntry.data member once the entry has been unlinked and
+ * released. The return value of cleanupFunc will be returned by
+ * ll_remove if cleanupFunc
  * is supplied otherwise the value in LinkedListEntry->data is returned.
  */
 void * ll_remove(LinkedListEntry *entry, void *(cleanupFunc)(void *));
@@ -116,9 +340,11 @@ void * ll_poll(LinkedList *list);
 void * ll_pop(LinkedList *list);
 
 /*
- * cleanupFunc is optional; if supplied it will be called against the
- * LinkedListEntry.data member prior to entry deallocation. The return
- * value of cleanupFunc is ignored in this case.
+ * cleanupFunc is optional; if supplied it will be called against each
+ * LinkedListEntry.data member once its entry has been unlinked. The
+ * return value of cleanupFunc is ignored in this case. The list's own
+ * entries are returned to the pool together once the whole list has
+ * been walked.
  */
 void ll_clear(LinkedList *list, void *(cleanupFunc(void *)));
 
@@ -174,4 +400,8 @@ LinkedList * ll_copyAdvanced(LinkedList *list,
                      void *deepCopyFuncParam,
                      void *(deepCopyFunc)(void *, void *));
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,463 @@
+//
+//  llist.hpp
+//  freememlist
+//
+//  Created by Kevin Carter on 8/4/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_llist_hpp
+#define freememlist_llist_hpp
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#ifdef LL_THREAD_SAFE
+#include <mutex>
+#endif
+#include "slab.h"
+
+/*
+ * A typed, header-only front-end to the list for C++ callers. The C API
+ * reaches every comparison, predicate and map through a function pointer
+ * and a void * cast; here they are template parameters (function
+ * objects or lambdas), so the compiler can inline them into the loops.
+ *
+ * List<T> keeps insertion order; List<T, Compare> stays sorted by
+ * Compare, a strict "sorts before" ordering such as std::less<T>, with
+ * equal values in insertion order. Values live inside the node rather
+ * than behind a data pointer and are moved in and out where possible.
+ * Nodes come from a slab pool per node type, as LinkedListEntry does in
+ * llist.c, guarded by a lock under LL_THREAD_SAFE. A List itself is not
+ * locked; callers share one between threads the way they would share a
+ * standard container.
+ *
+ * The member functions follow the C API (append, insert, poll, search,
+ * searchFindAll, mapInline, filterInline, ...) and behave the same way.
+ */
+namespace ll {
+
+/*
+ * The Compare of a List that keeps insertion order.
+ */
+struct Unordered {};
+
+template <typename T>
+struct Node {
+    Node *next;
+    Node *previous;
+    T value;
+
+    template <typename... Args>
+    explicit Node(Args&&... args) : next(nullptr), previous(nullptr), value(std::forward<Args>(args)...) {}
+};
+
+/*
+ * One slab pool per node type. Nodes too large for a slab, or aligned
+ * more strictly than a slab aligns its objects, come from operator new.
+ */
+template <typename NodeType>
+class NodePool {
+public:
+    static void *alloc() {
+        void *retval;
+        if(pooled) {
+#ifdef LL_THREAD_SAFE
+            std::lock_guard<std::mutex> guard(lock());
+#endif
+            retval = slab_alloc(&pool());
+            if(retval==nullptr) {
+                throw std::bad_alloc();
+            }
+        } else {
+            retval = ::operator new(sizeof(NodeType));
+        }
+        return retval;
+    }
+
+    static void release(void *node) {
+        if(pooled) {
+#ifdef LL_THREAD_SAFE
+            std::lock_guard<std::mutex> guard(lock());
+#endif
+            slab_free(node);
+        } else {
+            ::operator delete(node);
+        }
+    }
+
+private:
+    static const bool pooled = sizeof(NodeType) <= SLAB_BYTES/8 && alignof(NodeType) <= SLAB_ALIGNMENT;
+
+    static SlabPool &pool() {
+        static SlabPool instance = initialized();
+        return instance;
+    }
+
+    static SlabPool initialized() {
+        SlabPool instance;
+        slab_initialize(&instance, sizeof(NodeType));
+        return instance;
+    }
+
+#ifdef LL_THREAD_SAFE
+    static std::mutex &lock() {
+        static std::mutex instance;
+        return instance;
+    }
+#endif
+};
+
+template <typename T, typename Compare = Unordered>
+class List {
+    typedef Node<T> NodeType;
+    typedef NodePool<NodeType> Pool;
+
+public:
+    class iterator {
+    public:
+        iterator() : node(nullptr) {}
+        explicit iterator(NodeType *node) : node(node) {}
+        T &operator*() const { return node->value; }
+        T *operator->() const { return &node->value; }
+        iterator &operator++() { node = node->next; return *this; }
+        iterator operator++(int) { iterator previous(*this); node = node->next; return previous; }
+        bool operator==(const iterator &other) const { return node==other.node; }
+        bool operator!=(const iterator &other) const { return node!=other.node; }
+    private:
+        friend class List;
+        friend class const_iterator;
+        NodeType *node;
+    };
+
+    class const_iterator {
+    public:
+        const_iterator() : node(nullptr) {}
+        explicit const_iterator(const NodeType *node) : node(node) {}
+        const_iterator(const iterator &other) : node(other.node) {}
+        const T &operator*() const { return node->value; }
+        const T *operator->() const { return &node->value; }
+        const_iterator &operator++() { node = node->next; return *this; }
+        const_iterator operator++(int) { const_iterator previous(*this); node = node->next; return previous; }
+        bool operator==(const const_iterator &other) const { return node==other.node; }
+        bool operator!=(const const_iterator &other) const { return node!=other.node; }
+    private:
+        const NodeType *node;
+    };
+
+    explicit List(const Compare &compare = Compare()) : first(nullptr), last(nullptr), nodeCount(0), compare(compare) {}
+
+    List(List &&other) : first(other.first), last(other.last), nodeCount(other.nodeCount), compare(std::move(other.compare)) {
+        other.first = other.last = nullptr;
+        other.nodeCount = 0;
+    }
+
+    List &operator=(List &&other) {
+        if(this!=&other) {
+            clear();
+            first = other.first;
+            last = other.last;
+            nodeCount = other.nodeCount;
+            compare = std::move(other.compare);
+            other.first = other.last = nullptr;
+            other.nodeCount = 0;
+        }
+        return *this;
+    }
+
+    List(const List &) = delete;
+    List &operator=(const List &) = delete;
+
+    ~List() {
+        clear();
+    }
+
+    long size() const { return nodeCount; }
+    bool empty() const { return nodeCount==0; }
+    T &front() { return first->value; }
+    T &back() { return last->value; }
+    iterator begin() { return iterator(first); }
+    iterator end() { return iterator(); }
+    const_iterator begin() const { return const_iterator(first); }
+    const_iterator end() const { return const_iterator(); }
+
+    /*
+     * Adds value at the tail (append) or head (prepend) of an unordered
+     * list and in sorted position in a sorted one, as ll_append and
+     * ll_prepend do.
+     */
+    iterator append(const T &value) { return emplaceAppend(value); }
+    iterator append(T &&value) { return emplaceAppend(std::move(value)); }
+    iterator prepend(const T &value) { return emplacePrepend(value); }
+    iterator prepend(T &&value) { return emplacePrepend(std::move(value)); }
+
+    template <typename... Args>
+    iterator emplaceAppend(Args&&... args) {
+        return place(make(std::forward<Args>(args)...), last, Ordering());
+    }
+
+    template <typename... Args>
+    iterator emplacePrepend(Args&&... args) {
+        return place(make(std::forward<Args>(args)...), nullptr, Ordering());
+    }
+
+    /*
+     * ll_insert: the sorted position in a sorted list, the head of an
+     * unordered one.
+     */
+    iterator insert(const T &value) { return emplacePrepend(value); }
+    iterator insert(T &&value) { return emplacePrepend(std::move(value)); }
+
+    /*
+     * Removes the head (poll) or tail (pop), moving its value to out.
+     * Returns false, leaving out alone, on an empty list.
+     */
+    bool poll(T &out) {
+        bool retval = first!=nullptr;
+        if(retval) {
+            out = std::move(first->value);
+            destroy(unlink(first));
+        }
+        return retval;
+    }
+
+    bool pop(T &out) {
+        bool retval = last!=nullptr;
+        if(retval) {
+            out = std::move(last->value);
+            destroy(unlink(last));
+        }
+        return retval;
+    }
+
+    /*
+     * Removes the value at position and returns the one after it.
+     */
+    iterator remove(iterator position) {
+        NodeType *next = position.node->next;
+        destroy(unlink(position.node));
+        return iterator(next);
+    }
+
+    void clear() {
+        NodeType *node;
+        NodeType *next;
+        for(node=first;node!=nullptr;node=next) {
+            next = node->next;
+            destroy(node);
+        }
+        first = last = nullptr;
+        nodeCount = 0;
+    }
+
+    /*
+     * Returns the first value for which searchFunc is true, or nullptr.
+     */
+    template <typename Predicate>
+    T *search(Predicate searchFunc) {
+        NodeType *node;
+        for(node=first;node!=nullptr;node=node->next) {
+            if(searchFunc(node->value)) {
+                return &node->value;
+            }
+        }
+        return nullptr;
+    }
+
+    /*
+     * Returns a list of pointers to every value searchFunc returns
+     * non-zero for. As with ll_searchFindAll, a return of -1 counts as a
+     * match and ends the search.
+     */
+    template <typename Predicate>
+    List<T *> searchFindAll(Predicate searchFunc) {
+        List<T *> retval;
+        NodeType *node;
+        int sfRes = 0;
+        for(node=first;node!=nullptr && sfRes!=-1;node=node->next) {
+            if((sfRes = searchFunc(node->value))) {
+                retval.append(&node->value);
+            }
+        }
+        return retval;
+    }
+
+    /*
+     * Replaces every value with mapFunc(value). mapFunc must not change
+     * where a value sorts in a sorted list.
+     */
+    template <typename Map>
+    void mapInline(Map mapFunc) {
+        NodeType *node;
+        for(node=first;node!=nullptr;node=node->next) {
+            node->value = mapFunc(node->value);
+        }
+    }
+
+    /*
+     * Removes every value filterFunc returns true for.
+     */
+    template <typename Predicate>
+    void filterInline(Predicate filterFunc) {
+        NodeType *node;
+        NodeType *next;
+        for(node=first;node!=nullptr;node=next) {
+            next = node->next;
+            if(filterFunc(node->value)) {
+                destroy(unlink(node));
+            }
+        }
+    }
+
+    /*
+     * Stable merge sort by sortsBefore, relinking the nodes in place as
+     * ll_assignSortFunction does. Only meaningful for an unordered list;
+     * a sorted one is already in Compare order.
+     */
+    template <typename SortsBefore>
+    void sort(SortsBefore sortsBefore) {
+        NodeType *head = first;
+        NodeType *tail;
+        NodeType *p;
+        NodeType *q;
+        NodeType *taken;
+        long runLength;
+        long pSize;
+        long qSize;
+        long merges;
+
+        if(nodeCount<2) {
+            return;
+        }
+
+        for(runLength=1;;runLength*=2) {
+            p = head;
+            head = tail = nullptr;
+            merges = 0;
+            while(p!=nullptr) {
+                merges++;
+                for(q=p,pSize=0;pSize<runLength && q!=nullptr;pSize++) {
+                    q = q->next;
+                }
+                qSize = runLength;
+
+                while(pSize>0 || (qSize>0 && q!=nullptr)) {
+                    if(pSize==0 || (qSize>0 && q!=nullptr && sortsBefore(q->value, p->value))) {
+                        taken = q;
+                        q = q->next;
+                        qSize--;
+                    } else {
+                        taken = p;
+                        p = p->next;
+                        pSize--;
+                    }
+
+                    if(tail!=nullptr) {
+                        tail->next = taken;
+                    } else {
+                        head = taken;
+                    }
+                    tail = taken;
+                }
+                p = q;
+            }
+            tail->next = nullptr;
+
+            if(merges<=1) {
+                break;
+            }
+        }
+
+        first = head;
+        for(p=nullptr,q=head;q!=nullptr;p=q,q=q->next) {
+            q->previous = p;
+        }
+        last = p;
+    }
+
+private:
+    struct UnorderedTag {};
+    struct SortedTag {};
+    typedef typename std::conditional<std::is_same<Compare, Unordered>::value, UnorderedTag, SortedTag>::type Ordering;
+
+    NodeType *first;
+    NodeType *last;
+    long nodeCount;
+    Compare compare;
+
+    template <typename... Args>
+    static NodeType *make(Args&&... args) {
+        void *memory = Pool::alloc();
+        try {
+            return new(memory) NodeType(std::forward<Args>(args)...);
+        } catch(...) {
+            Pool::release(memory);
+            throw;
+        }
+    }
+
+    static void destroy(NodeType *node) {
+        node->~NodeType();
+        Pool::release(node);
+    }
+
+    /*
+     * Links node after previous, or at the head if previous is nullptr.
+     */
+    iterator link(NodeType *node, NodeType *previous) {
+        NodeType *next = (previous==nullptr ? first : previous->next);
+        node->previous = previous;
+        node->next = next;
+        if(previous!=nullptr) {
+            previous->next = node;
+        } else {
+            first = node;
+        }
+        if(next!=nullptr) {
+            next->previous = node;
+        } else {
+            last = node;
+        }
+        nodeCount++;
+        return iterator(node);
+    }
+
+    NodeType *unlink(NodeType *node) {
+        if(node->previous!=nullptr) {
+            node->previous->next = node->next;
+        } else {
+            first = node->next;
+        }
+        if(node->next!=nullptr) {
+            node->next->previous = node->previous;
+        } else {
+            last = node->previous;
+        }
+        nodeCount--;
+        return node;
+    }
+
+    iterator place(NodeType *node, NodeType *previous, UnorderedTag) {
+        return link(node, previous);
+    }
+
+    /*
+     * The sorted position is after the last node node does not sort
+     * before, wherever the caller asked for it to go.
+     */
+    iterator place(NodeType *node, NodeType *, SortedTag) {
+        NodeType *previous = last;
+        if(previous!=nullptr && compare(node->value, previous->value)) {
+            for(previous=first;previous!=nullptr && !compare(node->value, previous->value);previous=previous->next) {
+                //Empty loop
+            }
+            previous = (previous==nullptr ? last : previous->previous);
+        }
+        return link(node, previous);
+    }
+};
+
+}
+
+#endif
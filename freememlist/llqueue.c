@@ -0,0 +1,293 @@
+//
+//  llqueue.c
+//  freememlist
+//
+//  Created by Kevin Carter on 6/30/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+#include <stdlib.h>
+#include "llqueue.h"
+
+#ifdef LL_THREAD_SAFE
+
+#include <pthread.h>
+
+#define LQ_HAZARDS_PER_THREAD 2
+#define LQ_RETIRE_THRESHOLD 64
+
+#define lq_load(pointer) __atomic_load_n((pointer), __ATOMIC_SEQ_CST)
+#define lq_store(pointer, value) __atomic_store_n((pointer), (value), __ATOMIC_SEQ_CST)
+#define lq_cas(pointer, expected, desired) \
+    __atomic_compare_exchange_n((pointer), &(expected), (desired), 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+
+/*
+ * One hazard record per live thread. Records are never freed; a record
+ * left behind by an exited thread is marked inactive and adopted by the
+ * next thread that needs one.
+ */
+typedef struct lq_hazardRecord lq_hazardRecord;
+struct lq_hazardRecord {
+    lq_hazardRecord *next;
+    int active;
+    LinkedListEntry *hazards[LQ_HAZARDS_PER_THREAD];
+};
+
+/*
+ * Retired entries are chained through their previous pointer, which the
+ * queue itself never uses, because other threads may still follow next.
+ */
+typedef struct lq_threadState {
+    lq_hazardRecord *record;
+    LinkedListEntry *retired;
+    long retiredCount;
+} lq_threadState;
+
+static lq_hazardRecord *hazardRecords=NULL;
+static LinkedListEntry *orphanedEntries=NULL;
+static pthread_once_t threadKeyCreated=PTHREAD_ONCE_INIT;
+static pthread_key_t threadKey;
+static __thread lq_threadState threadState;
+
+static int lq_isHazardous(LinkedListEntry *entry) {
+    int retval=0;
+    int i;
+    lq_hazardRecord *record;
+    
+    for(record=lq_load(&hazardRecords);record!=NULL && !retval;record=record->next) {
+        for(i=0;i<LQ_HAZARDS_PER_THREAD && !retval;i++) {
+            retval=(lq_load(&record->hazards[i])==entry);
+        }
+    }
+    return retval;
+}
+
+/*
+ * Returns every retired entry no hazard pointer refers to to the entry
+ * pool. Entries orphaned by exited threads are adopted first.
+ */
+static void lq_scan(lq_threadState *state) {
+    LinkedListEntry *entry;
+    LinkedListEntry *next;
+    LinkedListEntry *stillHazardous=NULL;
+    LinkedListEntry *orphans=__atomic_exchange_n(&orphanedEntries, NULL, __ATOMIC_SEQ_CST);
+    
+    for(entry=orphans;entry!=NULL;entry=next) {
+        next=entry->previous;
+        entry->previous=state->retired;
+        state->retired=entry;
+        state->retiredCount++;
+    }
+    
+    for(entry=state->retired;entry!=NULL;entry=next) {
+        next=entry->previous;
+        if(lq_isHazardous(entry)) {
+            entry->previous=stillHazardous;
+            stillHazardous=entry;
+        } else {
+            state->retiredCount--;
+            ll_releaseEntry(entry);
+        }
+    }
+    state->retired=stillHazardous;
+}
+
+/*
+ * Runs as the thread exits, possibly after llist has already returned
+ * this thread's entry cache to the pool, so nothing here may release an
+ * entry: anything released now would sit in a cache no one drains. The
+ * retired entries are instead pushed onto orphanedEntries in one CAS
+ * for the next thread that scans to adopt.
+ */
+static void lq_releaseThreadState(void *statePointer) {
+    lq_threadState *state=statePointer;
+    LinkedListEntry *last;
+    LinkedListEntry *expected;
+    int i;
+    
+    if(state->record!=NULL) {
+        for(i=0;i<LQ_HAZARDS_PER_THREAD;i++) {
+            lq_store(&state->record->hazards[i], NULL);
+        }
+        
+        if(state->retired!=NULL) {
+            for(last=state->retired;last->previous!=NULL;last=last->previous) {
+                //Empty loop
+            }
+            expected=lq_load(&orphanedEntries);
+            do {
+                last->previous=expected;
+            } while(!lq_cas(&orphanedEntries, expected, state->retired));
+        }
+        state->retired=NULL;
+        state->retiredCount=0;
+        
+        lq_store(&state->record->active, 0);
+        state->record=NULL;
+    }
+}
+
+static void lq_createThreadKey() {
+    pthread_key_create(&threadKey, lq_releaseThreadState);
+}
+
+static lq_hazardRecord *lq_acquireRecord() {
+    lq_hazardRecord *record;
+    lq_hazardRecord *expected;
+    int inactive;
+    
+    for(record=lq_load(&hazardRecords);record!=NULL;record=record->next) {
+        inactive=0;
+        if(lq_load(&record->active)==0 && lq_cas(&record->active, inactive, 1)) {
+            break;
+        }
+    }
+    
+    if(record==NULL && (record=calloc(1, sizeof(*record)))!=NULL) {
+        record->active=1;
+        expected=lq_load(&hazardRecords);
+        do {
+            record->next=expected;
+        } while(!lq_cas(&hazardRecords, expected, record));
+    }
+    return record;
+}
+
+static lq_hazardRecord *lq_threadRecord() {
+    if(threadState.record==NULL) {
+        pthread_once(&threadKeyCreated, lq_createThreadKey);
+        if((threadState.record=lq_acquireRecord())!=NULL) {
+            pthread_setspecific(threadKey, &threadState);
+        }
+    }
+    return threadState.record;
+}
+
+static void lq_retire(LinkedListEntry *entry) {
+    entry->previous=threadState.retired;
+    threadState.retired=entry;
+    if(++threadState.retiredCount >= LQ_RETIRE_THRESHOLD) {
+        lq_scan(&threadState);
+    }
+}
+
+LinkedQueue *lq_create() {
+    LinkedQueue *queue=calloc(1, sizeof(*queue));
+    LinkedListEntry *dummy;
+    
+    if(queue!=NULL) {
+        if((dummy=ll_allocEntry(NULL))==NULL) {
+            free(queue);
+            queue=NULL;
+        } else {
+            queue->head=queue->tail=dummy;
+        }
+    }
+    return queue;
+}
+
+void lq_destroy(LinkedQueue *queue, void *(cleanupFunc)(void *)) {
+    void *data;
+    if(queue!=NULL) {
+        while(lq_count(queue)>0) {
+            data=lq_poll(queue);
+            if(cleanupFunc!=NULL) {
+                cleanupFunc(data);
+            }
+        }
+        ll_releaseEntry(queue->head);
+        free(queue);
+    }
+}
+
+int lq_append(LinkedQueue *queue, void *data) {
+    int retval=LL_SUCCESS;
+    LinkedListEntry *newEntry;
+    LinkedListEntry *tail;
+    LinkedListEntry *next;
+    LinkedListEntry *expected;
+    lq_hazardRecord *record;
+    
+    if(queue==NULL) {
+        retval=LL_NULL_LIST;
+    } else if((record=lq_threadRecord())==NULL || (newEntry=ll_allocEntry(data))==NULL) {
+        retval=LL_ERR_ALLOCATION_FAILED;
+    } else {
+        for(;;) {
+            tail=lq_load(&queue->tail);
+            lq_store(&record->hazards[0], tail);
+            if(tail!=lq_load(&queue->tail)) {
+                continue;
+            }
+            
+            next=lq_load(&tail->next);
+            if(next!=NULL) {
+                /* help a producer that linked but has not swung tail yet */
+                lq_cas(&queue->tail, tail, next);
+                continue;
+            }
+            
+            expected=NULL;
+            if(lq_cas(&tail->next, expected, newEntry)) {
+                lq_cas(&queue->tail, tail, newEntry);
+                break;
+            }
+        }
+        lq_store(&record->hazards[0], NULL);
+        __atomic_fetch_add(&queue->nodeCount, 1, __ATOMIC_SEQ_CST);
+    }
+    return retval;
+}
+
+void *lq_poll(LinkedQueue *queue) {
+    void *retval=NULL;
+    LinkedListEntry *head;
+    LinkedListEntry *tail;
+    LinkedListEntry *next;
+    lq_hazardRecord *record;
+    
+    if(queue!=NULL && (record=lq_threadRecord())!=NULL) {
+        for(;;) {
+            head=lq_load(&queue->head);
+            lq_store(&record->hazards[0], head);
+            if(head!=lq_load(&queue->head)) {
+                continue;
+            }
+            
+            tail=lq_load(&queue->tail);
+            next=lq_load(&head->next);
+            lq_store(&record->hazards[1], next);
+            if(head!=lq_load(&queue->head)) {
+                continue;
+            }
+            
+            if(next==NULL) {
+                head=NULL;
+                break;
+            }
+            
+            if(head==tail) {
+                lq_cas(&queue->tail, tail, next);
+                continue;
+            }
+            
+            retval=next->data;
+            if(lq_cas(&queue->head, head, next)) {
+                break;
+            }
+        }
+        
+        lq_store(&record->hazards[0], NULL);
+        lq_store(&record->hazards[1], NULL);
+        if(head!=NULL) {
+            __atomic_fetch_sub(&queue->nodeCount, 1, __ATOMIC_SEQ_CST);
+            lq_retire(head);
+        }
+    }
+    return retval;
+}
+
+long lq_count(LinkedQueue *queue) {
+    return (queue==NULL ? 0 : lq_load(&queue->nodeCount));
+}
+
+#endif
@@ -0,0 +1,71 @@
+//
+//  llqueue.h
+//  freememlist
+//
+//  Created by Kevin Carter on 6/30/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_llqueue_h
+#define freememlist_llqueue_h
+
+#include "llist.h"
+
+/*
+ * LinkedQueue is only available in LL_THREAD_SAFE builds, where the
+ * entry pool it draws from may be used from any thread.
+ */
+#ifdef LL_THREAD_SAFE
+
+#define LQ_CACHE_LINE 64
+
+typedef struct LinkedQueue LinkedQueue;
+
+/*
+ * A lock-free multi-producer/multi-consumer FIFO with the same
+ * append/poll/count surface as a LinkedList used as a queue (Michael &
+ * Scott's algorithm). head always points at a dummy entry; the entry
+ * after it holds the oldest element. head and tail sit on separate
+ * cache lines so producers and consumers do not false-share.
+ *
+ * Entries that leave the queue are retired through hazard pointers and
+ * only returned to the entry pool once no thread can still be reading
+ * them, so neither side ever waits for the other.
+ */
+struct LinkedQueue {
+    LinkedListEntry *head;
+    char headPadding[LQ_CACHE_LINE-sizeof(LinkedListEntry *)];
+    LinkedListEntry *tail;
+    char tailPadding[LQ_CACHE_LINE-sizeof(LinkedListEntry *)];
+    long nodeCount;
+};
+
+LinkedQueue *lq_create();
+
+/*
+ * Frees the queue, calling cleanupFunc (if supplied) on every element
+ * still in it. No other thread may be using the queue.
+ */
+void lq_destroy(LinkedQueue *queue, void *(cleanupFunc)(void *));
+
+/*
+ * Adds data at the tail. Returns LL_SUCCESS, LL_NULL_LIST or
+ * LL_ERR_ALLOCATION_FAILED.
+ */
+int lq_append(LinkedQueue *queue, void *data);
+
+/*
+ * Removes the element at the head and returns it. Returns NULL if the
+ * queue is empty.
+ */
+void *lq_poll(LinkedQueue *queue);
+
+/*
+ * Returns the number of elements in the queue. With concurrent callers
+ * this is a snapshot that may already be out of date.
+ */
+long lq_count(LinkedQueue *queue);
+
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+//
+//  llqueuetest.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/11/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#include <stdio.h>
+#include <pthread.h>
+#include "llqueue.h"
+
+#if !defined(LL_THREAD_SAFE) || !defined(LL_STATS)
+#error llqueuetest needs LL_THREAD_SAFE and LL_STATS
+#endif
+
+/*
+ * Checks that threads exiting with entries still retired in their
+ * hazard-pointer state, or parked in their entry cache, hand them on
+ * rather than losing them. Two checks run LQT_ROUNDS rounds each on one
+ * shared queue:
+ *
+ *   churn  LQT_THREADS threads that each append and poll, then exit
+ *   split  LQT_THREADS producers that only append, then LQT_THREADS
+ *          consumers that only poll, so the consumers release entries
+ *          without ever allocating one
+ *
+ * The entries a round leaves behind must be adopted by the next, so the
+ * number of live entries stays flat however many rounds run. Needs
+ * LL_THREAD_SAFE and LL_STATS (the llqueuetest target); exits non-zero
+ * on failure.
+ */
+
+#define LQT_THREADS 4
+#define LQT_ROUNDS 100
+#define LQT_OPERATIONS 1000
+
+/*
+ * Entries a round may legitimately leave live: each exited thread's
+ * retired entries wait for the next round to adopt them, and the queue
+ * keeps its dummy.
+ */
+#define LQT_SLACK (LQT_THREADS*256)
+
+static int lqt_started = 0;
+
+static void *lqt_churn(void *queue) {
+    long i;
+    long operations = LQT_OPERATIONS + __atomic_fetch_add(&lqt_started, 1, __ATOMIC_RELAXED)%7;
+    
+    /* uneven counts leave a different number of entries retired at each exit */
+    for(i=0;i<operations;i++) {
+        lq_append(queue, queue);
+        lq_poll(queue);
+    }
+    return NULL;
+}
+
+static void *lqt_produce(void *queue) {
+    long i;
+    
+    for(i=0;i<LQT_OPERATIONS;i++) {
+        lq_append(queue, queue);
+    }
+    return NULL;
+}
+
+static void *lqt_consume(void *queue) {
+    long i;
+    
+    for(i=0;i<LQT_OPERATIONS;i++) {
+        lq_poll(queue);
+    }
+    return NULL;
+}
+
+static void lqt_runThreads(LinkedQueue *queue, void *(body)(void *)) {
+    pthread_t threads[LQT_THREADS];
+    int i;
+    
+    for(i=0;i<LQT_THREADS;i++) {
+        pthread_create(&threads[i], NULL, body, queue);
+    }
+    for(i=0;i<LQT_THREADS;i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+static void lqt_churnRound(LinkedQueue *queue) {
+    lqt_runThreads(queue, lqt_churn);
+}
+
+static void lqt_splitRound(LinkedQueue *queue) {
+    lqt_runThreads(queue, lqt_produce);
+    lqt_runThreads(queue, lqt_consume);
+}
+
+static long lqt_liveEntries() {
+    LinkedListStats stats;
+    ll_getStats(&stats);
+    return stats.liveEntries;
+}
+
+/*
+ * Runs LQT_ROUNDS rounds and returns 0 if live entries grew by more than
+ * LQT_SLACK between the first and the last.
+ */
+static int lqt_check(const char *name, LinkedQueue *queue, void (round)(LinkedQueue *)) {
+    int retval = 1;
+    long firstRound = 0;
+    long lastRound = 0;
+    int i;
+    
+    for(i=0;i<LQT_ROUNDS;i++) {
+        round(queue);
+        lastRound = lqt_liveEntries();
+        if(i==0) {
+            firstRound = lastRound;
+        }
+    }
+    
+    if(lastRound-firstRound > LQT_SLACK) {
+        printf("llqueuetest: %s FAILED, %li live entries after %i rounds against %li after one\n",
+               name, lastRound, LQT_ROUNDS, firstRound);
+        retval = 0;
+    } else {
+        printf("llqueuetest: %s ok, %li live entries after %i rounds against %li after one\n",
+               name, lastRound, LQT_ROUNDS, firstRound);
+    }
+    return retval;
+}
+
+int main()
+{
+    int retval = 0;
+    LinkedQueue *queue = lq_create();
+    
+    if(queue==NULL) {
+        printf("llqueuetest: cannot create a queue\n");
+        retval = 1;
+    } else {
+        if(!lqt_check("churn", queue, lqt_churnRound)) {
+            retval = 1;
+        }
+        if(!lqt_check("split", queue, lqt_splitRound)) {
+            retval = 1;
+        }
+        lq_destroy(queue, NULL);
+    }
+    
+    return retval;
+}
@@ -10,18 +10,20 @@
 #include <string.h>
 #include <stdlib.h>
 #include "llist.h"
-
-typedef struct pageDef {
-    long start;
-    long end;
-}pageDef;
+#include "fml.h"
+#include "fmltrace.h"
+#include "fmlmem.h"
 
 typedef enum e_commandid {
     RESERVED,
     INIT,
     ALLOCATE,
     FREE,
-    PRINT
+    PRINT,
+    STATS,
+    FREEBATCH,
+    RESIZE,
+    ALLOCATE_ALIGNED
 } commandId;
 
 typedef struct commandStruct {
@@ -35,203 +37,227 @@ commandStruct commands[] = {
     {"allocate",ALLOCATE,1},
     {"free",FREE,1},
     {"print",PRINT,0},
+    {"stats",STATS,0},
+    {"freebatch",FREEBATCH,1},
+    {"resize",RESIZE,1},
+    {"allocate_aligned",ALLOCATE_ALIGNED,1},
     {0,0,0}
 };
 
 
-void *pageCleanupFunc(void *page) {
-//    printf("Freeing: %li\n", ((pageDef *) page)->);
-    free(page);
-    return NULL;
-}
-
-int sortComparator(LinkedListEntry *context[],void *newData) {
-    int retval = LL_SORT_DO_NOT_INSERT_YET;
-    LinkedListEntry *nextentry = context[LL_SORT_CONTEXT_NEXT];
-    LinkedListEntry *currententry = context[LL_SORT_CONTEXT_CURRENT];
-    
-    pageDef *currentPage = currententry->data;
-    pageDef *nextPage = (nextentry == NULL?NULL:nextentry->data);
-    pageDef *newPage = newData;
-    
-    
-    if(newPage->start<currentPage->start) {
-        retval = LL_SORT_INSERT_BEFORE_CURRENT;
-    } else if(newPage->start > currentPage->start) {
-        if(nextPage==NULL || newPage->start < nextPage->start) {
-            retval = LL_SORT_INSERT_AFTER_CURRENT;
-        }
-    }
-    
-//    if((int) newData < (int) currententry->data) {
-//        if(previousentry==NULL || (int) newData > (int) previousentry->data) {
-//            return LL_SORT_INSERT_BEFORE_CURRENT;
-//        }
-//    } else if((int) newData > (int) currententry->data) {
-//        return LL_SORT_INSERT_AFTER_CURRENT;
-//    }
-    
-    return retval;
-}
-
-
-void initializeFml(LinkedList **freeList, LinkedList **usedList,int blockCount) {
-    pageDef *page;
-    if(*freeList!=NULL) {
-        ll_destroy(*freeList, pageCleanupFunc);
-    }
-    
-    if(*usedList!=NULL) {
-        ll_destroy(*usedList, pageCleanupFunc);
-    }
-    
-    *freeList = ll_create();
-    ll_assignSortFunction(*freeList, sortComparator);
-    *usedList = ll_create();
-    ll_assignSortFunction(*usedList, sortComparator);
-    
-    page = malloc(sizeof(*page));
-    page->start=0;
-    page->end=blockCount-1;
-    ll_append(*freeList, page);
-}
-
 int prompt(char *buffer) {
     printf("$ ");
     return scanf("%s",buffer);
 }
 
-void *printBlock(void *data,void *param) {
-    pageDef *page = (pageDef *) data;
-    printf("%li-%li (size %li)\n",page->start,page->end,(page->end-page->start)+1);
-    return data;
+void printBlock(long start,long end,void *param) {
+    printf("%li-%li (size %li)\n",start,end,(end-start)+1);
 }
 
-void printData(LinkedList *freeList, LinkedList *usedList) {
+void printData(fmlArena *arena) {
     printf("Free memory:\n\n");
-    ll_mapInline(freeList, NULL, printBlock);
+    mapFmlBlocks(arena, 1, NULL, printBlock);
     
     printf("\nUsed memory:\n\n");
-    ll_mapInline(usedList, NULL, printBlock);
-}
-
-int isFreeBlockBigEnough(void *data, void *param) {
-    long requestedSize = *(long *) param;
-    pageDef *page = (pageDef *) data;
-    
-    return (page->end-page->start+1) >= requestedSize;
+    mapFmlBlocks(arena, 0, NULL, printBlock);
 }
 
-int performAllocation(LinkedList *freeList, LinkedList *usedList, long requestedSize, long *acquiredAddress) {
-    int retval = 1;
-    pageDef *acquiredpage;
-    pageDef *newPage;
-    LinkedListEntry *entry = ll_search(freeList, &requestedSize, isFreeBlockBigEnough);
+/*
+ * Reads an optional word following the numeric argument on the same
+ * line (the placement policy after init) into buffer, leaving it empty
+ * if the line ends first. The rest of the line is discarded.
+ */
+void readTrailingWord(char *buffer, int size) {
+    int c;
+    int length=0;
     
-    if(entry!=NULL) {
-        acquiredpage=(pageDef *)entry->data;
-        newPage=malloc(sizeof(*newPage));
-        newPage->start=acquiredpage->start;
-        newPage->end=newPage->start+requestedSize-1;
-        ll_append(usedList, newPage);
-        
-        acquiredpage->start+=requestedSize;
-        if(acquiredpage->start > acquiredpage->end) {
-            ll_remove(entry, pageCleanupFunc);
+    while((c=getchar())==' ' || c=='\t') {
+        //Empty loop
+    }
+    while(c!=EOF && c!='\n' && c!=' ' && c!='\t') {
+        if(length<size-1) {
+            buffer[length++]=(char) c;
         }
-        *acquiredAddress=newPage->start;
-    } else {
-        retval = 0;
+        c=getchar();
     }
-    return retval;
-}
-
-int searchForStartAddress(void *data, void *param) {
-    long baseBlockAddress = *(long *)param;
-    pageDef *page=(pageDef *)data;
-    return page->start == baseBlockAddress;
+    while(c!=EOF && c!='\n') {
+        c=getchar();
+    }
+    buffer[length]='\0';
 }
 
-int searchForEndAddress(void *data, void *param) {
-    long endBlockAddress = *(long *) param;
-    pageDef *page=(pageDef *)data;
-    return page->end == endBlockAddress;
+/*
+ * Converts a page count read at the prompt to bytes for the fmlm_
+ * calls. A count outside the region becomes one page more than it
+ * holds, which fails as it should instead of wrapping around to a
+ * small request. Before init there is no region and blockBytes is 0,
+ * so every count comes to 0 bytes, which the fmlm_ calls refuse.
+ */
+size_t pagesToBytes(fmlMemoryArena *memory, long pages) {
+    if(pages<0 || pages>memory->blockCount) {
+        pages = memory->blockCount+1;
+    }
+    return (size_t) pages*memory->blockBytes;
 }
 
-int performFree(LinkedList *freeList, LinkedList *usedList, long blockBaseAddress) {
-    int retval = 1;
-    long previousAdjacentAddress;
-    long nextAdjacentAddress;
-    pageDef *usedPage;
-    pageDef *newPage;
-    pageDef *previousAdjacentPage;
-    pageDef *nextAdjacentPage;
-    LinkedListEntry *previousAdjacentEntry;
-    LinkedListEntry *nextAdjacentEntry;
-    LinkedListEntry *entryToDeallocate = ll_search(usedList, &blockBaseAddress, searchForStartAddress);
+/*
+ * Frees the count addresses following a freebatch command in one
+ * performFreeBatch call and replies to each exactly as free would. A
+ * memory-backed arena frees them one at a time so each run can be
+ * released.
+ */
+void freeBatch(fmlArena *arena, fmlMemoryArena *memory, long count) {
+    long *addresses;
+    int *results;
+    long i;
     
-    if(entryToDeallocate!=NULL) {
-        usedPage=(pageDef *)entryToDeallocate->data;
-
-        previousAdjacentAddress=blockBaseAddress-1;
-        previousAdjacentEntry=ll_search(freeList, &previousAdjacentAddress, searchForEndAddress);
-        
-        if(previousAdjacentEntry) {
-            previousAdjacentPage=(pageDef *) previousAdjacentEntry->data;
-            previousAdjacentPage->end=usedPage->end;
-            usedPage=previousAdjacentPage;
+    addresses = malloc(count*sizeof(*addresses));
+    results = malloc(count*sizeof(*results));
+    if(count<=0 || addresses==NULL || results==NULL) {
+        printf("error, bad batch size\n\n");
+    } else {
+        for(i=0;i<count && scanf("%li",&addresses[i])==1;i++) {
+            //Empty loop
+        }
+        if(memory!=NULL) {
+            for(count=i,i=0;i<count;i++) {
+                results[i]=(fmlm_free(memory, fmlm_blockPointer(memory, addresses[i]))==FMLM_SUCCESS);
+            }
+        } else {
+            performFreeBatch(arena, addresses, i, results);
         }
-        
-        nextAdjacentAddress=usedPage->end+1;
-        nextAdjacentEntry = ll_search(freeList, &nextAdjacentAddress,searchForStartAddress);
-        
-        if(nextAdjacentEntry) {
-            nextAdjacentPage=(pageDef *)nextAdjacentEntry->data;
-            usedPage->end = nextAdjacentPage->end;
-            ll_remove(nextAdjacentEntry, pageCleanupFunc);
+        for(count=i,i=0;i<count;i++) {
+            printf(results[i] ? "ok\n\n" : "error, not an allocated block\n\n");
         }
-        
-        if(previousAdjacentEntry==NULL) {
-            newPage=malloc(sizeof(*newPage));
-            newPage->start=usedPage->start;
-            newPage->end=usedPage->end;
-            ll_append(freeList, newPage);
+    }
+    free(addresses);
+    free(results);
+}
+
+/*
+ * Reads the new size following a resize command and resizes the block
+ * at address, replying as allocate would with the block's address
+ * afterwards, or as free would if nothing is allocated there.
+ */
+void resizeBlock(fmlArena *arena, fmlMemoryArena *memory, long address) {
+    long newSize=0;
+    long newAddress=0;
+    void *pointer;
+    
+    scanf("%li",&newSize);
+    if(allocationBlocks(arena, address)==0) {
+        printf("error, not an allocated block\n\n");
+    } else if(newSize<=0) {
+        printf("error, bad size\n\n");
+    } else if(memory!=NULL) {
+        if((pointer=fmlm_reallocate(memory, fmlm_blockPointer(memory, address), pagesToBytes(memory, newSize)))!=NULL) {
+            printf("your address is %li (%p)\n\n",fmlm_blockOf(memory, pointer),pointer);
+        } else {
+            printf("error, no contiguous available\n\n");
         }
-        
-        ll_remove(entryToDeallocate,pageCleanupFunc);
-    }else {
-        retval = 0;
+    } else if(performResize(arena, address, newSize, &newAddress)) {
+        printf("your address is %li\n\n",newAddress);
+    } else {
+        printf("error, no contiguous available\n\n");
     }
+}
+
+/*
+ * Reads the alignment following an allocate_aligned command and
+ * allocates size blocks starting at a multiple of it, replying as
+ * allocate would.
+ */
+void allocateAligned(fmlArena *arena, fmlMemoryArena *memory, long size) {
+    long alignment=0;
+    long acquiredAddress=0;
+    void *pointer;
     
-    return retval;
+    scanf("%li",&alignment);
+    if(alignment<=0 || (alignment & (alignment-1))!=0) {
+        printf("error, alignment must be a power of two\n\n");
+    } else if(memory!=NULL) {
+        if((pointer=fmlm_allocateAligned(memory, pagesToBytes(memory, size), alignment))!=NULL) {
+            printf("your address is %li (%p)\n\n",fmlm_blockOf(memory, pointer),pointer);
+        } else {
+            printf("error, no contiguous available\n\n");
+        }
+    } else if(performAlignedAllocation(arena, size, alignment, &acquiredAddress)) {
+        printf("your address is %li\n\n",acquiredAddress);
+    } else {
+        printf("error, no contiguous available\n\n");
+    }
 }
 
-void executeCommand(LinkedList **freeList,
-                    LinkedList **usedList,
+/*
+ * memory is NULL unless the arena is memory-backed (-m), in which case
+ * arena is memory's and addresses are page numbers within its region.
+ */
+void executeCommand(fmlArena *arena,
+                    fmlMemoryArena *memory,
                     commandStruct *command,
-                    int numericArg){
+                    long numericArg,
+                    const char *word){
     long acquiredAddress=0;
+    void *pointer;
+    int policy;
+    int status;
     switch(command->id) {
         case INIT:
-            initializeFml(freeList, usedList, numericArg);
-            printf("Initialization complete\n\n");
+            policy = (word[0]=='\0' ? FML_POLICY_BESTFIT : lookupPolicy(word));
+            if(policy<0) {
+                printf("error, unknown placement policy\n\n");
+            } else if(memory!=NULL && fmlm_initialize(memory, numericArg, policy, memory->releaseThreshold)!=FMLM_SUCCESS) {
+                printf("error, cannot map %li pages\n\n", numericArg);
+            } else if(memory==NULL && (status=initializeFml(arena, numericArg, policy))!=FML_SUCCESS) {
+                if(status==FML_ERR_UNSUPPORTED_POLICY) {
+                    printf("error, %s arenas cannot be stored\n\n", fmlPolicyNames[policy]);
+                } else if(status==FML_ERR_BAD_SIZE) {
+                    printf("error, bad size\n\n");
+                } else {
+                    printf("error, cannot allocate %li blocks\n\n", numericArg);
+                }
+            } else {
+                printf("Initialization complete\n\n");
+            }
             break;
         case ALLOCATE:
-            if(performAllocation(*freeList,*usedList,numericArg,&acquiredAddress)){
+            if(memory!=NULL) {
+                if((pointer=fmlm_allocate(memory, pagesToBytes(memory, numericArg)))!=NULL) {
+                    printf("your address is %li (%p)\n\n",fmlm_blockOf(memory, pointer),pointer);
+                } else {
+                    printf("error, no contiguous available\n\n");
+                }
+            } else if(performAllocation(arena,numericArg,&acquiredAddress)){
                 printf("your address is %li\n\n",acquiredAddress);
             } else {
                 printf("error, no contiguous available\n\n");
             }
             break;
         case FREE:
-            if(performFree(*freeList,*usedList,numericArg)) {
+            if(memory!=NULL ? fmlm_free(memory, fmlm_blockPointer(memory, numericArg))==FMLM_SUCCESS
+                            : performFree(arena,numericArg)) {
                 printf("ok\n\n");
             } else {
                 printf("error, not an allocated block\n\n");
             }
             break;
+        case FREEBATCH:
+            freeBatch(arena, memory, numericArg);
+            break;
+        case RESIZE:
+            resizeBlock(arena, memory, numericArg);
+            break;
+        case ALLOCATE_ALIGNED:
+            allocateAligned(arena, memory, numericArg);
+            break;
         case PRINT:
-            printData(*freeList,*usedList);
+            printData(arena);
+            break;
+        case STATS:
+            printFmlStats(arena, stdout);
+            if(memory!=NULL) {
+                printf("Released: %li madvise calls covering %li pages\n\n", memory->releaseCalls, memory->releasedBlocks);
+            }
             break;
         case RESERVED:
         default:
@@ -243,11 +269,61 @@ int main(int argc, const char * argv[])
 {
     commandStruct *currentCommand=NULL;
     char command[1024];
-    LinkedList *freeList=NULL;
-    LinkedList *usedList=NULL;
-    int blockCount;
+    char word[1024];
+    fmlArena arena={0};
+    fmlMemoryArena memoryArena;
+    fmlMemoryArena *memory=NULL;
+    fmlArena *activeArena=&arena;
+    const char *programName=argv[0];
+    const char *storePath=NULL;
+    char *end;
     int i;
-    int numericArg=0;
+    long numericArg=0;
+    int dumpStats=0;
+    int status;
+    
+    memset(&memoryArena, 0, sizeof(memoryArena));
+    if(argc>1 && strcmp(argv[1], "-s")==0) {
+        dumpStats=1;
+        argv++;
+        argc--;
+    }
+    
+    if(argc>2 && strcmp(argv[1], "-p")==0) {
+        storePath=argv[2];
+        argv+=2;
+        argc-=2;
+    } else if(argc>1 && strcmp(argv[1], "-m")==0) {
+        /* an optional page count after -m sets the madvise threshold for every init */
+        memory=&memoryArena;
+        activeArena=&memoryArena.arena;
+        memoryArena.releaseThreshold=FMLM_DEFAULT_RELEASE_BLOCKS;
+        argv++;
+        argc--;
+        if(argc>1 && argv[1][0]>='0' && argv[1][0]<='9') {
+            memoryArena.releaseThreshold=strtol(argv[1], &end, 10);
+            if(*end!='\0') {
+                fprintf(stderr, "%s: bad release threshold %s\n", programName, argv[1]);
+                return 1;
+            }
+            argv++;
+            argc--;
+        }
+    }
+    
+    if(storePath==NULL && memory==NULL && argc==3 && strcmp(argv[1], "-b")==0) {
+        return ft_runTrace(argv[2], stdout, dumpStats);
+    } else if(storePath==NULL && memory==NULL && argc==4 && strcmp(argv[1], "-c")==0) {
+        return ft_compileTrace(argv[2], argv[3]);
+    } else if(argc!=1) {
+        fprintf(stderr, "usage: %s [-s] [-p store | -m [releasePages]] [-b trace | -c textTrace binaryTrace]\n", programName);
+        return 1;
+    }
+    
+    if(storePath!=NULL && (status=openFml(&arena, storePath, 0, FML_POLICY_BESTFIT))!=FS_SUCCESS) {
+        fprintf(stderr, "%s: cannot open %s (error %i)\n", programName, storePath, status);
+        return 1;
+    }
     
     while((EOF!=prompt(command))) {
         for(i=0;
@@ -256,17 +332,27 @@ int main(int argc, const char * argv[])
                 //Empty loop
         }
         if(currentCommand!=NULL){
+            word[0]='\0';
             if(currentCommand->requiresNumericSecondArg) {
-                scanf("%i",&numericArg);
+                scanf("%li",&numericArg);
+            }
+            if(currentCommand->id==INIT) {
+                readTrailingWord(word, sizeof(word));
             }
             
-            executeCommand(&freeList,&usedList,currentCommand,numericArg);
+            executeCommand(activeArena,memory,currentCommand,numericArg,word);
         }
     }
     
-    initializeFml(&freeList,&usedList, blockCount);
-    
+    if(dumpStats) {
+        printFmlStats(activeArena, stdout);
+    }
     
+    if(memory!=NULL) {
+        fmlm_destroy(memory);
+    } else {
+        destroyFml(&arena);
+    }
     
     return 0;
 }
@@ -0,0 +1,351 @@
+//
+//  sizeindex.c
+//  freememlist
+//
+//  Created by Kevin Carter on 6/2/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+#include <stdlib.h>
+#include "sizeindex.h"
+
+#define si_height(node) ((node)==NULL ? 0 : (node)->height)
+
+#define SI_MAX_ALIGNMENT ((int) sizeof(long)*8-1)
+
+static int si_compareKey(int order, long size, long start, SizeIndexNode *node) {
+    int retval = 0;
+    if(order==SI_ORDER_START) {
+        if(start < node->start) {
+            retval = -1;
+        } else if(start > node->start) {
+            retval = 1;
+        }
+    } else if(size < node->size) {
+        retval = -1;
+    } else if(size > node->size) {
+        retval = 1;
+    } else if(start < node->start) {
+        retval = -1;
+    } else if(start > node->start) {
+        retval = 1;
+    }
+    return retval;
+}
+
+/*
+ * Returns the largest k for which start..start+size-1 holds a multiple
+ * of 2^k: the highest bit that changes between start-1 and the last
+ * block. 0 is a multiple of everything.
+ */
+static int si_alignmentOf(long start, long size) {
+    unsigned long changed = (unsigned long) (start-1) ^ (unsigned long) (start+size-1);
+    int retval = -1;
+    if(start==0) {
+        retval = SI_MAX_ALIGNMENT;
+    } else if(size>0) {
+        retval = SI_MAX_ALIGNMENT - __builtin_clzl(changed);
+    }
+    return retval;
+}
+
+/*
+ * Recomputes height and the subtree maxima from node's children.
+ */
+static void si_updateHeight(SizeIndexNode *node) {
+    int leftHeight = si_height(node->left);
+    int rightHeight = si_height(node->right);
+    node->height = (leftHeight > rightHeight ? leftHeight : rightHeight) + 1;
+    node->maxSize = node->size;
+    node->maxAlignment = si_alignmentOf(node->start, node->size);
+    if(node->left!=NULL && node->left->maxSize > node->maxSize) {
+        node->maxSize = node->left->maxSize;
+    }
+    if(node->right!=NULL && node->right->maxSize > node->maxSize) {
+        node->maxSize = node->right->maxSize;
+    }
+    if(node->left!=NULL && node->left->maxAlignment > node->maxAlignment) {
+        node->maxAlignment = node->left->maxAlignment;
+    }
+    if(node->right!=NULL && node->right->maxAlignment > node->maxAlignment) {
+        node->maxAlignment = node->right->maxAlignment;
+    }
+}
+
+static SizeIndexNode *si_rotateRight(SizeIndexNode *node) {
+    SizeIndexNode *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    si_updateHeight(node);
+    si_updateHeight(pivot);
+    return pivot;
+}
+
+static SizeIndexNode *si_rotateLeft(SizeIndexNode *node) {
+    SizeIndexNode *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    si_updateHeight(node);
+    si_updateHeight(pivot);
+    return pivot;
+}
+
+static SizeIndexNode *si_rebalance(SizeIndexNode *node) {
+    int balance;
+    si_updateHeight(node);
+    balance = si_height(node->left) - si_height(node->right);
+    
+    if(balance > 1) {
+        if(si_height(node->left->left) < si_height(node->left->right)) {
+            node->left = si_rotateLeft(node->left);
+        }
+        node = si_rotateRight(node);
+    } else if(balance < -1) {
+        if(si_height(node->right->right) < si_height(node->right->left)) {
+            node->right = si_rotateRight(node->right);
+        }
+        node = si_rotateLeft(node);
+    }
+    return node;
+}
+
+static SizeIndexNode *si_insertNode(int order, SizeIndexNode *root, SizeIndexNode *node, int *result) {
+    int cmp;
+    if(root==NULL) {
+        return node;
+    }
+    
+    cmp = si_compareKey(order, node->size, node->start, root);
+    if(cmp < 0) {
+        root->left = si_insertNode(order, root->left, node, result);
+    } else if(cmp > 0) {
+        root->right = si_insertNode(order, root->right, node, result);
+    } else {
+        *result = SI_ERR_DUPLICATE_KEY;
+        return root;
+    }
+    return si_rebalance(root);
+}
+
+static SizeIndexNode *si_removeMin(SizeIndexNode *root, SizeIndexNode **min) {
+    if(root->left==NULL) {
+        *min = root;
+        return root->right;
+    }
+    root->left = si_removeMin(root->left, min);
+    return si_rebalance(root);
+}
+
+static SizeIndexNode *si_removeNode(int order, SizeIndexNode *root, SizeIndexNode *node, int *result) {
+    int cmp;
+    SizeIndexNode *replacement;
+    SizeIndexNode *right;
+    if(root==NULL) {
+        *result = SI_ERR_NODE_NOT_FOUND;
+        return NULL;
+    }
+    
+    cmp = si_compareKey(order, node->size, node->start, root);
+    if(cmp < 0) {
+        root->left = si_removeNode(order, root->left, node, result);
+    } else if(cmp > 0) {
+        root->right = si_removeNode(order, root->right, node, result);
+    } else if(root!=node) {
+        *result = SI_ERR_NODE_NOT_FOUND;
+        return root;
+    } else if(root->left==NULL) {
+        return root->right;
+    } else if(root->right==NULL) {
+        return root->left;
+    } else {
+        right = si_removeMin(root->right, &replacement);
+        replacement->left = root->left;
+        replacement->right = right;
+        root = replacement;
+    }
+    return si_rebalance(root);
+}
+
+void si_initialize(SizeIndex *index, int order) {
+    if(index!=NULL) {
+        index->root=NULL;
+        index->nodeCount=0;
+        index->order=order;
+    }
+}
+
+void si_clear(SizeIndex *index) {
+    if(index!=NULL) {
+        si_initialize(index, index->order);
+    }
+}
+
+int si_insert(SizeIndex *index, SizeIndexNode *node, long start, long size) {
+    int retval = SI_SUCCESS;
+    if(index==NULL) {
+        retval = SI_NULL_INDEX;
+    } else {
+        node->left=node->right=NULL;
+        node->height=1;
+        node->size=size;
+        node->maxSize=size;
+        node->start=start;
+        node->maxAlignment=si_alignmentOf(start, size);
+        index->root = si_insertNode(index->order, index->root, node, &retval);
+        if(retval==SI_SUCCESS) {
+            index->nodeCount++;
+        }
+    }
+    return retval;
+}
+
+int si_remove(SizeIndex *index, SizeIndexNode *node) {
+    int retval = SI_SUCCESS;
+    if(index==NULL) {
+        retval = SI_NULL_INDEX;
+    } else {
+        index->root = si_removeNode(index->order, index->root, node, &retval);
+        if(retval==SI_SUCCESS) {
+            index->nodeCount--;
+            node->left=node->right=NULL;
+        }
+    }
+    return retval;
+}
+
+SizeIndexNode *si_findSmallestAtLeast(SizeIndex *index, long size) {
+    SizeIndexNode *retval = NULL;
+    SizeIndexNode *node = (index==NULL ? NULL : index->root);
+    
+    while(node!=NULL) {
+        if(node->size >= size) {
+            retval = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return retval;
+}
+
+static SizeIndexNode *si_lowestAtLeast(SizeIndexNode *node, long size) {
+    SizeIndexNode *retval = NULL;
+    
+    while(node!=NULL && node->maxSize >= size) {
+        if(node->left!=NULL && node->left->maxSize >= size) {
+            node = node->left;
+        } else if(node->size >= size) {
+            retval = node;
+            node = NULL;
+        } else {
+            node = node->right;
+        }
+    }
+    return retval;
+}
+
+SizeIndexNode *si_findLowestAtLeast(SizeIndex *index, long size) {
+    return (index==NULL ? NULL : si_lowestAtLeast(index->root, size));
+}
+
+/*
+ * Only one path descends through nodes starting before fromStart; once a
+ * subtree lies entirely at or after it the plain first-fit descent takes
+ * over, so the search stays logarithmic.
+ */
+static SizeIndexNode *si_findFrom(SizeIndexNode *node, long fromStart, long size) {
+    SizeIndexNode *retval = NULL;
+    
+    if(node!=NULL && node->maxSize >= size) {
+        if(node->start < fromStart) {
+            retval = si_findFrom(node->right, fromStart, size);
+        } else {
+            retval = si_findFrom(node->left, fromStart, size);
+            if(retval==NULL && node->size >= size) {
+                retval = node;
+            } else if(retval==NULL) {
+                retval = si_lowestAtLeast(node->right, size);
+            }
+        }
+    }
+    return retval;
+}
+
+SizeIndexNode *si_findLowestAtLeastFrom(SizeIndex *index, long fromStart, long size) {
+    return (index==NULL ? NULL : si_findFrom(index->root, fromStart, size));
+}
+
+SizeIndexNode *si_findLargest(SizeIndex *index) {
+    SizeIndexNode *retval = NULL;
+    if(index!=NULL && index->root!=NULL) {
+        if(index->order==SI_ORDER_START) {
+            retval = si_findLowestAtLeast(index, index->root->maxSize);
+        } else {
+            retval = si_findSmallestAtLeast(index, index->root->maxSize);
+        }
+    }
+    return retval;
+}
+
+static int si_fitsAligned(SizeIndexNode *node, long size, long alignment) {
+    long alignedStart = (node->start+alignment-1) & ~(alignment-1);
+    return alignedStart+size <= node->start+node->size;
+}
+
+/*
+ * Walks the nodes of at least minSize blocks in index order, skipping
+ * any subtree whose maxSize or maxAlignment rules it out and, by
+ * address, anything starting before fromStart, and returns the first
+ * with room for size aligned blocks.
+ */
+static SizeIndexNode *si_alignedAscending(SizeIndexNode *node, int order, long fromStart,
+                                          long minSize, long size, long alignment) {
+    SizeIndexNode *retval = NULL;
+    
+    if(node!=NULL && node->maxSize >= minSize && node->maxAlignment >= __builtin_ctzl(alignment)) {
+        if(order==SI_ORDER_START && node->start < fromStart) {
+            retval = si_alignedAscending(node->right, order, fromStart, minSize, size, alignment);
+        } else {
+            retval = si_alignedAscending(node->left, order, fromStart, minSize, size, alignment);
+            if(retval==NULL && node->size >= minSize && si_fitsAligned(node, size, alignment)) {
+                retval = node;
+            } else if(retval==NULL) {
+                retval = si_alignedAscending(node->right, order, fromStart, minSize, size, alignment);
+            }
+        }
+    }
+    return retval;
+}
+
+static SizeIndexNode *si_alignedDescending(SizeIndexNode *node, long size, long alignment) {
+    SizeIndexNode *retval = NULL;
+    
+    if(node!=NULL && node->maxSize >= size && node->maxAlignment >= __builtin_ctzl(alignment)) {
+        retval = si_alignedDescending(node->right, size, alignment);
+        if(retval==NULL && node->size >= size && si_fitsAligned(node, size, alignment)) {
+            retval = node;
+        } else if(retval==NULL) {
+            retval = si_alignedDescending(node->left, size, alignment);
+        }
+    }
+    return retval;
+}
+
+SizeIndexNode *si_findSmallestAlignedAtLeast(SizeIndex *index, long size, long alignment) {
+    return (index==NULL ? NULL : si_alignedAscending(index->root, SI_ORDER_SIZE, 0, size, size, alignment));
+}
+
+SizeIndexNode *si_findLowestAlignedAtLeastFrom(SizeIndex *index, long fromStart, long size, long alignment) {
+    return (index==NULL ? NULL : si_alignedAscending(index->root, SI_ORDER_START, fromStart, size, size, alignment));
+}
+
+/*
+ * The descent finds the largest size with room, at its highest address;
+ * the lowest node of that size with room is then found from the bottom.
+ */
+SizeIndexNode *si_findLargestAligned(SizeIndex *index, long size, long alignment) {
+    SizeIndexNode *retval = (index==NULL ? NULL : si_alignedDescending(index->root, size, alignment));
+    if(retval!=NULL) {
+        retval = si_alignedAscending(index->root, SI_ORDER_SIZE, 0, retval->size, size, alignment);
+    }
+    return retval;
+}
@@ -0,0 +1,129 @@
+//
+//  sizeindex.h
+//  freememlist
+//
+//  Created by Kevin Carter on 6/2/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_sizeindex_h
+#define freememlist_sizeindex_h
+
+#include <stddef.h>
+
+#define SI_SUCCESS 0
+#define SI_ERR_DUPLICATE_KEY 1
+#define SI_ERR_NODE_NOT_FOUND 2
+#define SI_NULL_INDEX 3
+
+#define SI_ORDER_SIZE 0
+#define SI_ORDER_START 1
+
+/*
+ * Recovers the structure a SizeIndexNode is embedded in, e.g.
+ * SI_CONTAINER_OF(node, pageDef, sizeNode).
+ */
+#define SI_CONTAINER_OF(node, type, member) \
+    ((type *)((char *)(node) - offsetof(type, member)))
+
+typedef struct SizeIndexNode SizeIndexNode;
+typedef struct SizeIndex SizeIndex;
+
+/*
+ * Nodes are embedded in the structure being indexed so the index never
+ * allocates. The key is the (size, start) pair, which is unique for
+ * non-overlapping extents. A node's key must not be changed while it is
+ * in an index; si_remove it, adjust, and si_insert it again. maxSize is
+ * the largest size anywhere in the node's subtree and maxAlignment the
+ * largest k for which some extent in it holds a multiple of 2^k.
+ */
+struct SizeIndexNode {
+    SizeIndexNode *left;
+    SizeIndexNode *right;
+    long size;
+    long start;
+    long maxSize;
+    int maxAlignment;
+    int height;
+};
+
+/*
+ * An AVL tree of extents ordered either by size and then by start
+ * address (SI_ORDER_SIZE) or by start address alone (SI_ORDER_START).
+ * Either way every node carries its subtree's maximum size, which is
+ * what lets an address-ordered index answer first-fit queries without a
+ * scan.
+ */
+struct SizeIndex {
+    SizeIndexNode *root;
+    long nodeCount;
+    int order;
+};
+
+void si_initialize(SizeIndex *index, int order);
+
+/*
+ * Forgets every node in the index. The nodes themselves belong to the
+ * caller and are not touched.
+ */
+void si_clear(SizeIndex *index);
+
+/*
+ * Adds node to the index under the key (size, start). Returns
+ * SI_ERR_DUPLICATE_KEY if an extent with the same key is already present.
+ */
+int si_insert(SizeIndex *index, SizeIndexNode *node, long start, long size);
+
+/*
+ * Removes node from the index. Returns SI_ERR_NODE_NOT_FOUND if node is
+ * not a member of index.
+ */
+int si_remove(SizeIndex *index, SizeIndexNode *node);
+
+/*
+ * Returns the node with the smallest size that is at least size. Ties are
+ * broken by the lowest start address. Returns NULL if every indexed extent
+ * is smaller than size. SI_ORDER_SIZE only.
+ */
+SizeIndexNode *si_findSmallestAtLeast(SizeIndex *index, long size);
+
+/*
+ * Returns the node with the lowest start address whose size is at least
+ * size, or NULL. SI_ORDER_START only.
+ */
+SizeIndexNode *si_findLowestAtLeast(SizeIndex *index, long size);
+
+/*
+ * As si_findLowestAtLeast, but only considers nodes starting at or after
+ * fromStart. SI_ORDER_START only.
+ */
+SizeIndexNode *si_findLowestAtLeastFrom(SizeIndex *index, long fromStart, long size);
+
+/*
+ * Returns the largest node, breaking ties by the lowest start address,
+ * or NULL if the index is empty. Works in either order.
+ */
+SizeIndexNode *si_findLargest(SizeIndex *index);
+
+/*
+ * Aligned counterparts of the searches above, which only return a node
+ * with room for size blocks starting at a multiple of alignment, a
+ * power of two. Subtrees are skipped unless they hold a node of at
+ * least size blocks and a node spanning a multiple of alignment, and any
+ * node of size+alignment-1 blocks or more has room wherever it starts.
+ * That skips the gaps left between aligned blocks, which span no
+ * aligned address, so a search over them stays logarithmic. It is not a
+ * bound: the two maxima may come from different nodes, and a node can
+ * span an aligned address too close to its end, so in the worst case a
+ * search tests every node of at least size blocks, O(n).
+ */
+SizeIndexNode *si_findSmallestAlignedAtLeast(SizeIndex *index, long size, long alignment);
+SizeIndexNode *si_findLowestAlignedAtLeastFrom(SizeIndex *index, long fromStart, long size, long alignment);
+
+/*
+ * Returns the largest node with room for the aligned block, breaking
+ * ties by the lowest start address, or NULL. SI_ORDER_SIZE only.
+ */
+SizeIndexNode *si_findLargestAligned(SizeIndex *index, long size, long alignment);
+
+#endif
@@ -0,0 +1,189 @@
+//
+//  slab.c
+//  freememlist
+//
+//  Created by Kevin Carter on 6/16/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+#include <stdlib.h>
+#include <stdint.h>
+#include "slab.h"
+
+#define slab_roundUp(value) (((value)+SLAB_ALIGNMENT-1) & ~((size_t)SLAB_ALIGNMENT-1))
+
+/*
+ * The header sits at the start of the slab's own memory. Objects that
+ * have never been handed out are carved by bumping nextUnused, so a new
+ * slab does not have to thread its free list up front.
+ */
+struct Slab {
+    Slab *next;
+    Slab *previous;
+    SlabPool *pool;
+    void *freeObjects;
+    char *nextUnused;
+    long liveCount;
+};
+
+#define slab_firstObject(slab) ((char *)(slab) + slab_roundUp(sizeof(Slab)))
+#define slab_end(slab) ((char *)(slab) + SLAB_BYTES)
+
+static void slab_push(Slab **list, Slab *slab) {
+    slab->previous=NULL;
+    slab->next=*list;
+    if(*list!=NULL) {
+        (*list)->previous=slab;
+    }
+    *list=slab;
+}
+
+static void slab_unlink(Slab **list, Slab *slab) {
+    if(slab->previous!=NULL) {
+        slab->previous->next=slab->next;
+    } else {
+        *list=slab->next;
+    }
+    if(slab->next!=NULL) {
+        slab->next->previous=slab->previous;
+    }
+    slab->next=slab->previous=NULL;
+}
+
+static int slab_isFull(Slab *slab) {
+    return slab->freeObjects==NULL &&
+        slab->nextUnused+slab->pool->objectSize > slab_end(slab);
+}
+
+static Slab *slab_create(SlabPool *pool) {
+    Slab *slab=NULL;
+    void *memory;
+    
+    if(posix_memalign(&memory, SLAB_BYTES, SLAB_BYTES)==0) {
+        slab=memory;
+        slab->next=slab->previous=NULL;
+        slab->pool=pool;
+        slab->freeObjects=NULL;
+        slab->nextUnused=slab_firstObject(slab);
+        slab->liveCount=0;
+        pool->slabCount++;
+    }
+    return slab;
+}
+
+static void slab_destroy(Slab *slab) {
+    slab->pool->slabCount--;
+    free(slab);
+}
+
+int slab_initialize(SlabPool *pool, size_t objectSize) {
+    int retval=SLAB_SUCCESS;
+    
+    if(pool==NULL) {
+        retval=SLAB_NULL_POOL;
+    } else {
+        if(objectSize<sizeof(void *)) {
+            objectSize=sizeof(void *);
+        }
+        pool->objectSize=slab_roundUp(objectSize);
+        pool->objectsPerSlab=(SLAB_BYTES-slab_roundUp(sizeof(Slab)))/pool->objectSize;
+        pool->partialSlabs=pool->fullSlabs=pool->emptySlab=NULL;
+        pool->slabCount=0;
+        pool->liveObjects=0;
+        if(pool->objectsPerSlab==0) {
+            retval=SLAB_ERR_OBJECT_TOO_LARGE;
+        }
+    }
+    return retval;
+}
+
+void *slab_alloc(SlabPool *pool) {
+    void *retval=NULL;
+    Slab *slab=pool->partialSlabs;
+    
+    if(slab==NULL) {
+        if((slab=pool->emptySlab)!=NULL) {
+            pool->emptySlab=NULL;
+        } else {
+            slab=slab_create(pool);
+        }
+        
+        if(slab!=NULL) {
+            slab_push(&pool->partialSlabs, slab);
+        }
+    }
+    
+    if(slab!=NULL) {
+        if(slab->freeObjects!=NULL) {
+            retval=slab->freeObjects;
+            slab->freeObjects=*(void **)retval;
+        } else {
+            retval=slab->nextUnused;
+            slab->nextUnused+=pool->objectSize;
+        }
+        slab->liveCount++;
+        pool->liveObjects++;
+        
+        if(slab_isFull(slab)) {
+            slab_unlink(&pool->partialSlabs, slab);
+            slab_push(&pool->fullSlabs, slab);
+        }
+    }
+    return retval;
+}
+
+void slab_free(void *object) {
+    Slab *slab;
+    SlabPool *pool;
+    int wasFull;
+    
+    if(object!=NULL) {
+        slab=(Slab *)((uintptr_t)object & ~((uintptr_t)SLAB_BYTES-1));
+        pool=slab->pool;
+        wasFull=slab_isFull(slab);
+        
+        *(void **)object=slab->freeObjects;
+        slab->freeObjects=object;
+        slab->liveCount--;
+        pool->liveObjects--;
+        
+        if(wasFull) {
+            slab_unlink(&pool->fullSlabs, slab);
+            slab_push(&pool->partialSlabs, slab);
+        }
+        
+        if(slab->liveCount==0) {
+            slab_unlink(&pool->partialSlabs, slab);
+            slab->freeObjects=NULL;
+            slab->nextUnused=slab_firstObject(slab);
+            if(pool->emptySlab==NULL) {
+                pool->emptySlab=slab;
+            } else {
+                slab_destroy(slab);
+            }
+        }
+    }
+}
+
+void slab_trim(SlabPool *pool) {
+    if(pool!=NULL && pool->emptySlab!=NULL) {
+        slab_destroy(pool->emptySlab);
+        pool->emptySlab=NULL;
+    }
+}
+
+void slab_releaseAll(SlabPool *pool) {
+    Slab *slab;
+    
+    if(pool!=NULL) {
+        while((slab=pool->partialSlabs)!=NULL) {
+            slab_unlink(&pool->partialSlabs, slab);
+            slab_destroy(slab);
+        }
+        while((slab=pool->fullSlabs)!=NULL) {
+            slab_unlink(&pool->fullSlabs, slab);
+            slab_destroy(slab);
+        }
+        slab_trim(pool);
+        pool->liveObjects=0;
+    }
+}
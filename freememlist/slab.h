@@ -0,0 +1,87 @@
+//
+//  slab.h
+//  freememlist
+//
+//  Created by Kevin Carter on 6/16/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_slab_h
+#define freememlist_slab_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SLAB_SUCCESS 0
+#define SLAB_ERR_OBJECT_TOO_LARGE 1
+#define SLAB_NULL_POOL 2
+
+/*
+ * Every slab is SLAB_BYTES long and aligned to SLAB_BYTES, which lets
+ * slab_free find an object's slab by masking its address.
+ */
+#define SLAB_BYTES 65536
+
+/*
+ * Every object handed out is aligned to SLAB_ALIGNMENT bytes.
+ */
+#define SLAB_ALIGNMENT 16
+
+typedef struct Slab Slab;
+typedef struct SlabPool SlabPool;
+
+/*
+ * A pool of equally sized objects carved from large, aligned chunks.
+ * Released objects go onto their slab's LIFO free list, so the most
+ * recently freed (and most likely cached) object is handed out next.
+ * A slab whose objects have all been released is returned to the
+ * system, except that one empty slab is kept back so a pool hovering
+ * around a slab boundary does not map and unmap on every call.
+ */
+struct SlabPool {
+    size_t objectSize;
+    size_t objectsPerSlab;
+    Slab *partialSlabs;
+    Slab *fullSlabs;
+    Slab *emptySlab;
+    long slabCount;
+    long liveObjects;
+};
+
+/*
+ * Prepares pool to hand out objects of objectSize bytes. No memory is
+ * reserved until the first slab_alloc.
+ */
+int slab_initialize(SlabPool *pool, size_t objectSize);
+
+/*
+ * Returns an uninitialised object or NULL if a new slab was needed and
+ * could not be allocated.
+ */
+void *slab_alloc(SlabPool *pool);
+
+/*
+ * Returns object, which must have come from slab_alloc, to its pool.
+ */
+void slab_free(void *object);
+
+/*
+ * Returns the cached empty slab, if any, to the system.
+ */
+void slab_trim(SlabPool *pool);
+
+/*
+ * Returns every slab to the system in one pass regardless of the
+ * objects still allocated from them. Every object from the pool becomes
+ * invalid; the pool itself may be used again afterwards.
+ */
+void slab_releaseAll(SlabPool *pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
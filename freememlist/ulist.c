@@ -0,0 +1,421 @@
+//
+//  ulist.c
+//  freememlist
+//
+//  Created by Kevin Carter on 7/28/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+#include <stdlib.h>
+#include <memory.h>
+#include "ulist.h"
+#include "slab.h"
+
+#ifdef LL_THREAD_SAFE
+#include <pthread.h>
+
+#define UL_LOCK(list) pthread_mutex_lock(&(list)->lock)
+#define UL_UNLOCK(list) pthread_mutex_unlock(&(list)->lock)
+#else
+#define UL_LOCK(list) ((void)(list))
+#define UL_UNLOCK(list) ((void)(list))
+#endif
+
+/*
+ * Asks for the node after the one being scanned while the current
+ * array is worked through; the arrays themselves are read front to back
+ * and left to the hardware prefetcher.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define UL_PREFETCH(node) __builtin_prefetch(node)
+#else
+#define UL_PREFETCH(node) ((void)(node))
+#endif
+
+#ifndef LL_SYSTEM_ALLOCATION
+
+static SlabPool nodePool={0};
+static SlabPool listPool={0};
+
+#ifdef LL_THREAD_SAFE
+static pthread_mutex_t poolLock=PTHREAD_MUTEX_INITIALIZER;
+#define UL_POOL_LOCK() pthread_mutex_lock(&poolLock)
+#define UL_POOL_UNLOCK() pthread_mutex_unlock(&poolLock)
+#else
+#define UL_POOL_LOCK()
+#define UL_POOL_UNLOCK()
+#endif
+
+static void *ul_poolAlloc(SlabPool *pool, size_t objectSize) {
+    void *retval=NULL;
+
+    UL_POOL_LOCK();
+    if(pool->objectSize!=0 || slab_initialize(pool, objectSize)==SLAB_SUCCESS) {
+        retval=slab_alloc(pool);
+    }
+    UL_POOL_UNLOCK();
+    if(retval!=NULL) {
+        memset(retval, 0, objectSize);
+    }
+    return retval;
+}
+
+static void ul_poolFree(void *object) {
+    UL_POOL_LOCK();
+    slab_free(object);
+    UL_POOL_UNLOCK();
+}
+
+#define ul_allocNode() ((UnrolledListNode *)ul_poolAlloc(&nodePool, sizeof(UnrolledListNode)))
+#define ul_releaseNode(node) ul_poolFree(node)
+#define ul_allocList() ((UnrolledList *)ul_poolAlloc(&listPool, sizeof(UnrolledList)))
+#define ul_releaseListMemory(list) ul_poolFree(list)
+
+#else
+
+#define ul_allocNode() ((UnrolledListNode *)calloc(1, sizeof(UnrolledListNode)))
+#define ul_releaseNode(node) free(node)
+#define ul_allocList() ((UnrolledList *)calloc(1, sizeof(UnrolledList)))
+#define ul_releaseListMemory(list) free(list)
+
+#endif
+
+/*
+ * Links a new, empty node between previous and next (either may be
+ * NULL) and returns it, or NULL if no node could be allocated.
+ */
+static UnrolledListNode *ul_linkNode(UnrolledList *list, UnrolledListNode *previous, UnrolledListNode *next) {
+    UnrolledListNode *node=ul_allocNode();
+
+    if(node!=NULL) {
+        node->previous=previous;
+        node->next=next;
+        if(previous!=NULL) {
+            previous->next=node;
+        } else {
+            list->first=node;
+        }
+        if(next!=NULL) {
+            next->previous=node;
+        } else {
+            list->last=node;
+        }
+        list->nodeCount++;
+    }
+    return node;
+}
+
+static void ul_unlinkNode(UnrolledList *list, UnrolledListNode *node) {
+    if(node->previous!=NULL) {
+        node->previous->next=node->next;
+    } else {
+        list->first=node->next;
+    }
+    if(node->next!=NULL) {
+        node->next->previous=node->previous;
+    } else {
+        list->last=node->previous;
+    }
+    list->nodeCount--;
+    ul_releaseNode(node);
+}
+
+/*
+ * Restores the node invariant after an element has been taken out of
+ * node: an empty node is dropped, otherwise node absorbs its successor
+ * or is absorbed by its predecessor if the two fit in one node.
+ */
+static void ul_rebalance(UnrolledList *list, UnrolledListNode *node) {
+    UnrolledListNode *neighbour;
+
+    if(node->count==0) {
+        ul_unlinkNode(list, node);
+    } else if((neighbour=node->next)!=NULL && node->count+neighbour->count<=UL_NODE_CAPACITY) {
+        memcpy(&node->data[node->count], neighbour->data, neighbour->count*sizeof(void *));
+        node->count+=neighbour->count;
+        ul_unlinkNode(list, neighbour);
+    } else if((neighbour=node->previous)!=NULL && neighbour->count+node->count<=UL_NODE_CAPACITY) {
+        memcpy(&neighbour->data[neighbour->count], node->data, node->count*sizeof(void *));
+        neighbour->count+=node->count;
+        ul_unlinkNode(list, node);
+    }
+}
+
+static void *ul_removeAt(UnrolledList *list, UnrolledListNode *node, long index) {
+    void *retval=node->data[index];
+
+    node->count--;
+    memmove(&node->data[index], &node->data[index+1], (node->count-index)*sizeof(void *));
+    list->elementCount--;
+    ul_rebalance(list, node);
+    return retval;
+}
+
+UnrolledList *ul_create() {
+    UnrolledList *list=ul_allocList();
+#ifdef LL_THREAD_SAFE
+    pthread_mutexattr_t lockAttributes;
+
+    if(list!=NULL) {
+        /* as with LinkedList, callbacks may call back into the list */
+        pthread_mutexattr_init(&lockAttributes);
+        pthread_mutexattr_settype(&lockAttributes, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&list->lock, &lockAttributes);
+        pthread_mutexattr_destroy(&lockAttributes);
+    }
+#endif
+    return list;
+}
+
+void ul_destroy(UnrolledList *list, void *(cleanupFunc)(void *)) {
+    if(list!=NULL) {
+        ul_clear(list, cleanupFunc);
+#ifdef LL_THREAD_SAFE
+        pthread_mutex_destroy(&list->lock);
+#endif
+        ul_releaseListMemory(list);
+    }
+}
+
+void ul_clear(UnrolledList *list, void *(cleanupFunc)(void *)) {
+    UnrolledListNode *node;
+    UnrolledListNode *next;
+    long i;
+
+    if(list!=NULL) {
+        UL_LOCK(list);
+        for(node=list->first;node!=NULL;node=next) {
+            next=node->next;
+            UL_PREFETCH(next);
+            if(cleanupFunc!=NULL) {
+                for(i=0;i<node->count;i++) {
+                    cleanupFunc(node->data[i]);
+                }
+            }
+            ul_releaseNode(node);
+        }
+        list->first=list->last=NULL;
+        list->nodeCount=list->elementCount=0;
+        UL_UNLOCK(list);
+    }
+}
+
+int ul_append(UnrolledList *list, void *data) {
+    int retval=UL_SUCCESS;
+    UnrolledListNode *node;
+
+    if(list==NULL) {
+        retval=UL_NULL_LIST;
+    } else {
+        UL_LOCK(list);
+        node=list->last;
+        if(node==NULL || node->count==UL_NODE_CAPACITY) {
+            node=ul_linkNode(list, node, NULL);
+        }
+
+        if(node==NULL) {
+            retval=UL_ERR_ALLOCATION_FAILED;
+        } else {
+            node->data[node->count++]=data;
+            list->elementCount++;
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+int ul_prepend(UnrolledList *list, void *data) {
+    int retval=UL_SUCCESS;
+    UnrolledListNode *node;
+
+    if(list==NULL) {
+        retval=UL_NULL_LIST;
+    } else {
+        UL_LOCK(list);
+        node=list->first;
+        if(node==NULL || node->count==UL_NODE_CAPACITY) {
+            node=ul_linkNode(list, NULL, node);
+        }
+
+        if(node==NULL) {
+            retval=UL_ERR_ALLOCATION_FAILED;
+        } else {
+            memmove(&node->data[1], &node->data[0], node->count*sizeof(void *));
+            node->data[0]=data;
+            node->count++;
+            list->elementCount++;
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+void *ul_poll(UnrolledList *list) {
+    void *retval=NULL;
+
+    if(list!=NULL) {
+        UL_LOCK(list);
+        if(list->first!=NULL) {
+            retval=ul_removeAt(list, list->first, 0);
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+void *ul_pop(UnrolledList *list) {
+    void *retval=NULL;
+
+    if(list!=NULL) {
+        UL_LOCK(list);
+        if(list->last!=NULL) {
+            retval=ul_removeAt(list, list->last, list->last->count-1);
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+void *ul_get(UnrolledList *list, long index) {
+    void *retval=NULL;
+    UnrolledListNode *node;
+    long remaining;
+
+    if(list!=NULL && index>=0) {
+        UL_LOCK(list);
+        if(index<list->elementCount) {
+            if(index<list->elementCount/2) {
+                remaining=index;
+                for(node=list->first;remaining>=node->count;node=node->next) {
+                    remaining-=node->count;
+                }
+            } else {
+                /* count back from the tail for the second half */
+                remaining=list->elementCount-index;
+                for(node=list->last;remaining>node->count;node=node->previous) {
+                    remaining-=node->count;
+                }
+                remaining=node->count-remaining;
+            }
+            retval=node->data[remaining];
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+void *ul_search(UnrolledList *list,
+                void *searchParam,
+                int (searchFunc)(void *, void *),
+                long *foundIndex) {
+    void *retval=NULL;
+    UnrolledListNode *node;
+    long base=0;
+    long match=-1;
+    long i;
+
+    if(list!=NULL && searchFunc!=NULL) {
+        UL_LOCK(list);
+        for(node=list->first;node!=NULL && match<0;node=node->next) {
+            UL_PREFETCH(node->next);
+            for(i=0;i<node->count;i++) {
+                if(searchFunc(node->data[i], searchParam)) {
+                    retval=node->data[i];
+                    match=base+i;
+                    break;
+                }
+            }
+            base+=node->count;
+        }
+        UL_UNLOCK(list);
+    }
+
+    if(foundIndex!=NULL) {
+        *foundIndex=match;
+    }
+    return retval;
+}
+
+UnrolledList *ul_searchFindAll(UnrolledList *list,
+                               void *searchParam,
+                               int (searchFunc)(void *, void *)) {
+    UnrolledList *retval=NULL;
+    UnrolledListNode *node;
+    int sfRes=0;
+    long i;
+
+    if(list!=NULL && searchFunc!=NULL && (retval=ul_create())!=NULL) {
+        UL_LOCK(list);
+        for(node=list->first;node!=NULL && sfRes!=-1;node=node->next) {
+            UL_PREFETCH(node->next);
+            for(i=0;i<node->count && sfRes!=-1;i++) {
+                if((sfRes=searchFunc(node->data[i], searchParam))) {
+                    ul_append(retval, node->data[i]);
+                }
+            }
+        }
+        UL_UNLOCK(list);
+    }
+    return retval;
+}
+
+void ul_mapInline(UnrolledList *list, void *mapParam, void *(mapFunc)(void *, void *)) {
+    UnrolledListNode *node;
+    long i;
+
+    if(list!=NULL && mapFunc!=NULL) {
+        UL_LOCK(list);
+        for(node=list->first;node!=NULL;node=node->next) {
+            UL_PREFETCH(node->next);
+            for(i=0;i<node->count;i++) {
+                node->data[i]=mapFunc(node->data[i], mapParam);
+            }
+        }
+        UL_UNLOCK(list);
+    }
+}
+
+/*
+ * Compacts the survivors towards the head in a single pass. The write
+ * position never overtakes the read position, so elements are only
+ * overwritten once they have been looked at; nodes left empty at the
+ * tail are released at the end.
+ */
+void ul_filterInline(UnrolledList *list, void *filterParam, int (filterFunc)(void *, void *)) {
+    UnrolledListNode *node;
+    UnrolledListNode *writeNode;
+    UnrolledListNode *next;
+    long writeIndex=0;
+    long i;
+
+    if(list!=NULL && filterFunc!=NULL) {
+        UL_LOCK(list);
+        writeNode=list->first;
+        for(node=list->first;node!=NULL;node=node->next) {
+            UL_PREFETCH(node->next);
+            for(i=0;i<node->count;i++) {
+                if(filterFunc(node->data[i], filterParam)) {
+                    list->elementCount--;
+                } else {
+                    if(writeIndex==UL_NODE_CAPACITY) {
+                        writeNode->count=UL_NODE_CAPACITY;
+                        writeNode=writeNode->next;
+                        writeIndex=0;
+                    }
+                    writeNode->data[writeIndex++]=node->data[i];
+                }
+            }
+        }
+
+        if(writeNode!=NULL) {
+            writeNode->count=writeIndex;
+            for(node=writeNode->next;node!=NULL;node=next) {
+                next=node->next;
+                ul_unlinkNode(list, node);
+            }
+            if(writeNode->count==0) {
+                ul_unlinkNode(list, writeNode);
+            }
+        }
+        UL_UNLOCK(list);
+    }
+}
@@ -0,0 +1,143 @@
+//
+//  ulist.h
+//  freememlist
+//
+//  Created by Kevin Carter on 7/28/14.
+//  Copyright (c) 2014 Kevin Carter. All rights reserved.
+//
+
+#ifndef freememlist_ulist_h
+#define freememlist_ulist_h
+
+#ifdef LL_THREAD_SAFE
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UL_SUCCESS 0
+#define UL_NULL_LIST 1
+#define UL_ERR_ALLOCATION_FAILED 2
+
+/*
+ * Elements held by one node. Together with the node's links and count
+ * this makes a node exactly 128 bytes, two cache lines on current
+ * hardware, with the elements in one contiguous array.
+ */
+#define UL_NODE_CAPACITY 13
+
+typedef struct UnrolledListNode UnrolledListNode;
+typedef struct UnrolledList UnrolledList;
+
+struct UnrolledListNode {
+    UnrolledListNode *next;
+    UnrolledListNode *previous;
+    long count;
+    void *data[UL_NODE_CAPACITY];
+};
+
+/*
+ * An unrolled list: a doubly linked chain of nodes that each hold up to
+ * UL_NODE_CAPACITY data pointers in order. Scans walk each node's array
+ * and follow one next pointer per UL_NODE_CAPACITY elements, prefetching
+ * the following node while the current one is processed, so a long
+ * search touches a fraction of the cache lines the same search over a
+ * LinkedList does.
+ *
+ * Elements are addressed by their data pointer rather than by an entry,
+ * so the list suits scanned collections (search, map, filter, findAll,
+ * queue operations); use a LinkedList when entries must be held on to
+ * and removed individually. Removal compacts the affected node and
+ * merges it into its neighbour once both fit in one node, so any two
+ * neighbouring nodes together hold more than UL_NODE_CAPACITY elements.
+ *
+ * Nodes come from a shared slab pool (one calloc each with
+ * LL_SYSTEM_ALLOCATION). With LL_THREAD_SAFE every list carries its own
+ * recursive lock, taken by each public function for the duration of the
+ * call, as LinkedList does.
+ */
+struct UnrolledList {
+    UnrolledListNode *first;
+    UnrolledListNode *last;
+    long nodeCount;
+    long elementCount;
+#ifdef LL_THREAD_SAFE
+    pthread_mutex_t lock;
+#endif
+};
+
+UnrolledList *ul_create();
+
+/*
+ * Calls ul_clear and then frees the list.
+ */
+void ul_destroy(UnrolledList *list, void *(cleanupFunc)(void *));
+
+/*
+ * Removes every element, calling cleanupFunc (if supplied) on each
+ * one's data. The return value of cleanupFunc is ignored.
+ */
+void ul_clear(UnrolledList *list, void *(cleanupFunc)(void *));
+
+/*
+ * Adds data at the tail or the head. Returns UL_SUCCESS, UL_NULL_LIST or
+ * UL_ERR_ALLOCATION_FAILED.
+ */
+int ul_append(UnrolledList *list, void *data);
+int ul_prepend(UnrolledList *list, void *data);
+
+/*
+ * Remove the element at the head (ul_poll) or tail (ul_pop) and return
+ * its data. Return NULL on an empty list.
+ */
+void *ul_poll(UnrolledList *list);
+void *ul_pop(UnrolledList *list);
+
+/*
+ * Returns the data of the element at index (counted from the head) or
+ * NULL if index is out of range.
+ */
+void *ul_get(UnrolledList *list, long index);
+
+/*
+ * Scans from the head until searchFunc, passed each element's data and
+ * searchParam, returns 1, and returns that element's data. Returns NULL
+ * if list or searchFunc is NULL or no element matches; pass foundIndex
+ * to tell a match on NULL data from no match, it is set to the index of
+ * the match or -1.
+ */
+void *ul_search(UnrolledList *list,
+                void *searchParam,
+                int (searchFunc)(void *, void *),
+                long *foundIndex);
+
+/*
+ * Applies searchFunc to every element and returns a new list holding
+ * the data of each element it returned 1 for. A return of -1 also counts
+ * as a match but ends the scan. The returned list shares the data
+ * pointers, so destroy it with a NULL cleanupFunc.
+ */
+UnrolledList *ul_searchFindAll(UnrolledList *list,
+                               void *searchParam,
+                               int (searchFunc)(void *, void *));
+
+/*
+ * Replaces each element's data with the return value of mapFunc, passed
+ * the data and mapParam.
+ */
+void ul_mapInline(UnrolledList *list, void *mapParam, void *(mapFunc)(void *, void *));
+
+/*
+ * Removes every element for which filterFunc, passed the data and
+ * filterParam, returns 1. As with ll_filterInline, filterFunc must do
+ * any cleanup of the data itself. The survivors keep their order.
+ */
+void ul_filterInline(UnrolledList *list, void *filterParam, int (filterFunc)(void *, void *));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif